@@ -9,30 +9,109 @@
 #include "std_types.h"
 #include "type_name.h"
 #include "log.h"
-#include <deque>
+#include "jobs.h"
+#include "ecs_storage.h"
+#include "ecs_soa.h"
+#include <span>
+#include <memory>
+#include <tuple>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <numeric>
+#include <functional>
 
 namespace fresa::ecs
 {
     //* index-version id
-    //      this is a numerical handle composed of a version and an index, being the version the first 16 bits and the index the last 16 bits
+    //      this is a numerical handle composed of a version and an index, being the version the upper bits and the index the lower bits
     //      the index is the entity handle, while the version exists to reuse deleted entity ids
     //      the id meant to be aliased for the types that require it, such as the entity and sparse set
+    //      the number of bits of each part is set with ecs_index_bits() and ecs_version_bits() in the engine config, and the
+    //      underlying types are the smallest unsigned integers that fit them (16/16 uses 32 bit ids, 32/32 uses 64 bit ids)
     namespace detail 
     {
-        using ID = strong::Type<ui32, decltype([]{}), strong::Regular, strong::Bitwise, strong::BitwiseWith<int>>;
+        //: smallest unsigned integer type with at least n bits
+        template <ui32 N>
+        using uint_fit = std::conditional_t<N <= 8, ui8, std::conditional_t<N <= 16, ui16, std::conditional_t<N <= 32, ui32, ui64>>>;
+
+        //: bit layout
+        constexpr ui32 index_bits = engine_config.ecs_index_bits();
+        constexpr ui32 version_bits = engine_config.ecs_version_bits();
+        static_assert(index_bits > 0 and version_bits > 0 and index_bits + version_bits <= 64, "invalid ecs id layout, index and version bits must fit in 64 bits");
+
+        using id_t = uint_fit<index_bits + version_bits>;
+        constexpr id_t index_mask = (id_t(1) << index_bits) - 1;
+        constexpr id_t version_mask = (id_t(1) << (version_bits - 1) << 1) - 1;
+
+        using ID = strong::Type<id_t, decltype([]{}), strong::Regular, strong::Bitwise, strong::BitwiseWith<int>>;
     }
-    using Index = strong::Type<ui16, decltype([]{}), strong::Regular, strong::ConvertibleTo<detail::ID>, strong::Hashable>;
-    using Version = strong::Type<ui16, decltype([]{}), strong::Regular, strong::ConvertibleTo<detail::ID>, strong::Ordered, strong::Arithmetic>;
+    using Index = strong::Type<detail::uint_fit<detail::index_bits>, decltype([]{}), strong::Regular, strong::ConvertibleTo<detail::ID>, strong::Hashable>;
+    using Version = strong::Type<detail::uint_fit<detail::version_bits>, decltype([]{}), strong::Regular, strong::ConvertibleTo<detail::ID>, strong::Ordered, strong::Arithmetic>;
 
-    [[nodiscard]] constexpr Index index(detail::ID id) noexcept { return Index(id.value); }
-    [[nodiscard]] constexpr Version version(detail::ID id) noexcept { return Version((id >> 16).value); }
-    [[nodiscard]] constexpr detail::ID id(Index i, Version v) noexcept { return (detail::ID(v) << 16) | detail::ID(i); }
+    [[nodiscard]] constexpr Index index(detail::ID id) noexcept { return Index(id.value & detail::index_mask); }
+    [[nodiscard]] constexpr Version version(detail::ID id) noexcept { return Version((id.value >> detail::index_bits) & detail::version_mask); }
+    [[nodiscard]] constexpr detail::ID id(Index i, Version v) noexcept {
+        return detail::ID(((detail::id_t(v.value) & detail::version_mask) << detail::index_bits) | (detail::id_t(i.value) & detail::index_mask));
+    }
 
-    constexpr detail::ID invalid_id = id(-1, 0);
+    //: the last index is reserved for the invalid id, so a scene can hold up to max_entities alive at the same time
+    constexpr detail::ID invalid_id = id(detail::index_mask, 0);
+    constexpr std::size_t max_entities = detail::index_mask;
 
     //: alias for entities
     using EntityID = detail::ID;
 
+    //: scene tick used for change tracking, it starts at 1 and is advanced with Scene::advance()
+    using Tick = ui32;
+
+    //* component signature
+    //      every component type gets a dense id the first time it is used, and each entity index stores a bitmask with the ids
+    //      of the components it has, so scenes can find the pools of an entity without asking every pool
+    namespace detail
+    {
+        //: maximum number of component types with a signature bit
+        constexpr ui32 max_components = engine_config.ecs_max_components();
+
+        //: signature bitmask
+        struct Signature {
+            static constexpr std::size_t words = (max_components + 63) / 64;
+            std::array<ui64, words> bits = {};
+
+            constexpr void set(const ui32 c) noexcept { bits[c / 64] |= ui64(1) << (c % 64); }
+            constexpr void reset(const ui32 c) noexcept { bits[c / 64] &= ~(ui64(1) << (c % 64)); }
+            [[nodiscard]] constexpr bool test(const ui32 c) const noexcept { return bits[c / 64] & (ui64(1) << (c % 64)); }
+            [[nodiscard]] constexpr bool none() const noexcept { return std::all_of(bits.begin(), bits.end(), [](ui64 w) { return w == 0; }); }
+
+            //: true if every bit of the other signature is also set in this one
+            [[nodiscard]] constexpr bool contains(const Signature& other) const noexcept {
+                for (std::size_t w = 0; w < words; w++) if ((bits[w] & other.bits[w]) != other.bits[w]) return false;
+                return true;
+            }
+
+            //: union
+            constexpr Signature& operator|=(const Signature& other) noexcept {
+                for (std::size_t w = 0; w < words; w++) bits[w] |= other.bits[w];
+                return *this;
+            }
+
+            //: calls f(c) for every set bit
+            template <typename F>
+            constexpr void each(F&& f) const {
+                for (std::size_t w = 0; w < words; w++)
+                    for (auto b = bits[w]; b != 0; b &= b - 1) f(ui32(w * 64 + std::countr_zero(b)));
+            }
+        };
+
+        //: dense component ids, assigned in order of first use
+        inline std::atomic<ui32> component_counter = 0;
+        template <typename C>
+        [[nodiscard]] inline ui32 component_id() {
+            static const ui32 id = component_counter.fetch_add(1);
+            return id;
+        }
+    }
+
     //---
 
     //* component pool
@@ -40,8 +119,94 @@ namespace fresa::ecs
     //      the pool base is used to store references to the component pool in a hashed type map for later access
     //      the pool is a sparse set that stores the components using a dense array
 
+    //: memory held by a component pool in bytes, including the unused capacity of its arrays
+    //      bookkeeping counts the change tracking ticks, the removal log and the observer event buffers
+    struct PoolMemory {
+        std::size_t entities = 0;
+        std::size_t sparse_pages = 0;
+        std::size_t sparse_bytes = 0;
+        std::size_t dense_size = 0;
+        std::size_t dense_capacity = 0;
+        std::size_t dense_bytes = 0;
+        std::size_t data_bytes = 0;
+        std::size_t bookkeeping_bytes = 0;
+
+        [[nodiscard]] constexpr std::size_t bytes() const noexcept { return sparse_bytes + dense_bytes + data_bytes + bookkeeping_bytes; }
+        [[nodiscard]] constexpr double bytes_per_entity() const noexcept { return entities > 0 ? double(bytes()) / double(entities) : 0.0; }
+
+        constexpr PoolMemory& operator+=(const PoolMemory& other) noexcept {
+            entities += other.entities; sparse_pages += other.sparse_pages; sparse_bytes += other.sparse_bytes;
+            dense_size += other.dense_size; dense_capacity += other.dense_capacity; dense_bytes += other.dense_bytes;
+            data_bytes += other.data_bytes; bookkeeping_bytes += other.bookkeeping_bytes;
+            return *this;
+        }
+    };
+
     namespace detail
     {
+        //: paged sparse array
+        //      the sparse array is divided in pages of ecs_page_size() ids that are allocated the first time they are used
+        //      pages are indexed directly by their position in a vector of pointers, with null meaning the page is missing,
+        //      so a lookup is a division and a pointer check without any hashing
+        struct SparseArray {
+            //: page types
+            static constexpr std::size_t page_size = engine_config.ecs_page_size();
+            using Page = std::array<ID, page_size>;
+
+            //: page pointers and number of allocated pages
+            std::vector<std::unique_ptr<Page>> pages;
+            std::size_t allocated = 0;
+
+            //: find page
+            //      returns the page for the given page number if it exists, nullptr if not
+            [[nodiscard]] constexpr Page* find(const std::size_t page) const noexcept {
+                return page < pages.size() ? pages[page].get() : nullptr;
+            }
+
+            //: assure page
+            //      returns the page for the given page number, creating it and filling it with invalid ids if it doesn't exist
+            constexpr Page& assure(const std::size_t page) {
+                if (page >= pages.size())
+                    pages.resize(page + 1);
+                if (pages[page] == nullptr) {
+                    pages[page] = std::make_unique<Page>();
+                    pages[page]->fill(invalid_id);
+                    allocated++;
+                }
+                return *pages[page];
+            }
+
+            //: page access, the page must exist
+            [[nodiscard]] constexpr Page& at(const std::size_t page) { return *pages.at(page); }
+            [[nodiscard]] constexpr const Page& at(const std::size_t page) const { return *pages.at(page); }
+
+            //: number of allocated pages
+            [[nodiscard]] constexpr std::size_t size() const noexcept { return allocated; }
+
+            //: clear
+            constexpr void clear() noexcept { pages.clear(); allocated = 0; }
+
+            //: compact
+            //      releases the pages that don't hold any of the used indices, and the missing pages at the end of the pointer array
+            void compact(std::span<const Index> used) {
+                std::vector<bool> live(pages.size(), false);
+                for (const auto i : used) live[i.value / page_size] = true;
+                for (std::size_t p = 0; p < pages.size(); p++)
+                    if (not live[p] and pages[p] != nullptr) { pages[p].reset(); allocated--; }
+                while (not pages.empty() and pages.back() == nullptr) pages.pop_back();
+                pages.shrink_to_fit();
+            }
+
+            //: bytes allocated by the pages and the pointer array
+            [[nodiscard]] constexpr std::size_t bytes() const noexcept {
+                return allocated * sizeof(Page) + pages.capacity() * sizeof(std::unique_ptr<Page>);
+            }
+        };
+
+        //: owning group and cached query, declared later
+        struct GroupBase;
+        struct QueryBase;
+
         //: base component pool
         struct ComponentPoolBase {
             //: default constructor, no copy or move
@@ -56,20 +221,65 @@ namespace fresa::ecs
             using SparseID = detail::ID;
 
             //: main array pair, sparse and dense
-            std::unordered_map<Index, std::array<SparseID, engine_config.ecs_page_size()>> sparse;
+            SparseArray sparse;
             std::vector<Index> dense;
 
+            //: group that owns this pool and keeps its dense order in sync with the other pools of the group, if any
+            GroupBase* group = nullptr;
+
+            //: cached queries that include this pool, they are notified when entities are added to or removed from it
+            std::vector<QueryBase*> queries;
+
+            //: signatures of the scene that owns this pool and the component id of the pool, which is set in them for every entity in it
+            //      standalone pools and pools of types past ecs_max_components() don't have signatures
+            std::vector<Signature>* signatures = nullptr;
+            ui32 component = max_components;
+
+            //: set or reset the signature bit of this pool for an entity index
+            constexpr void sign(const std::size_t i) {
+                if (signatures == nullptr) return;
+                if (i >= signatures->size()) signatures->resize(i + 1);
+                (*signatures)[i].set(component);
+            }
+            constexpr void unsign(const std::size_t i) {
+                if (signatures != nullptr and i < signatures->size()) (*signatures)[i].reset(component);
+            }
+
+            //: change tracking, disabled by default (see track())
+            //      added_ticks and changed_ticks run parallel to the dense array and store the tick at which each component was added
+            //      and last modified, while removed_ticks logs the entities removed from the pool along with the tick of their removal
+            //      tick is the current tick of the scene, which it updates on every advance
+            bool tracked = false;
+            Tick tick = 0;
+            std::vector<Tick> added_ticks;
+            std::vector<Tick> changed_ticks;
+            std::vector<std::pair<EntityID, Tick>> removed_ticks;
+
+            //: observers, see Scene::on_add, on_remove and on_update
+            //      while a pool has observers of a kind of event, the entities it adds, removes or updates are appended to the buffer
+            //      of that kind, and dispatch() delivers each buffer to its observers in a single call
+            enum Event : ui8 { Added, Removed, Updated };
+            using Observer = std::function<void(std::span<const EntityID>)>;
+            std::array<std::vector<Observer>, 3> observers;
+            std::array<std::vector<EntityID>, 3> events;
+            std::array<std::vector<EntityID>, 3> batch;
+
+            //: record an event, if there is anyone listening to it
+            constexpr void record(const Event e, const EntityID entity) {
+                if (not observers[e].empty()) events[e].push_back(entity);
+            }
+
             //: get sparse
             //      gets the entity index and sees if it is included in the sparse array
             [[nodiscard]] constexpr const SparseID* sparse_at(const EntityID entity) const {
-                const auto pos = index(entity).value;
-                const auto page = pos / engine_config.ecs_page_size();
-                return sparse.contains(page) ? &(sparse.at(page).at(pos % engine_config.ecs_page_size())) : nullptr;
+                const std::size_t pos = index(entity).value;
+                const auto page = sparse.find(pos / SparseArray::page_size);
+                return page != nullptr ? &(*page)[pos % SparseArray::page_size] : nullptr;
             }
             [[nodiscard]] constexpr SparseID* sparse_at(const EntityID entity) {
-                const auto pos = index(entity).value;
-                const auto page = pos / engine_config.ecs_page_size();
-                return sparse.contains(page) ? &(sparse.at(page).at(pos % engine_config.ecs_page_size())) : nullptr;
+                const std::size_t pos = index(entity).value;
+                const auto page = sparse.find(pos / SparseArray::page_size);
+                return page != nullptr ? &(*page)[pos % SparseArray::page_size] : nullptr;
             }
 
             //: is valid
@@ -83,80 +293,602 @@ namespace fresa::ecs
             [[nodiscard]] constexpr bool contains(const EntityID entity) const {
                 return valid(sparse_at(entity), version(entity));
             }
+
+            //: entity at
+            //      returns the entity stored in a position of the dense array, using the sparse array to recover its version
+            [[nodiscard]] constexpr EntityID entity_at(const std::size_t pos) const {
+                return id(dense[pos], version(*sparse_at(dense[pos].value)));
+            }
+
+            //: size
+            [[nodiscard]] constexpr std::size_t size() const { return dense.size(); }
             
-            //: remove is a constexpr virtual functions that is overriden by the derived classes
+            //: dense position of an entity, it must be contained in the pool
+            [[nodiscard]] constexpr std::size_t position(const EntityID entity) const {
+                return index(*sparse_at(entity)).value;
+            }
+
+            //: track
+            //      enables change tracking for this pool, the components already in it are stamped with the current tick
+            constexpr void track() {
+                if (tracked) return;
+                tracked = true;
+                added_ticks.assign(dense.size(), tick);
+                changed_ticks.assign(dense.size(), tick);
+            }
+
+            //: touch
+            //      marks the component of an entity as changed in the current tick, writes through references don't do it automatically
+            constexpr void touch(const EntityID entity) {
+                if (not contains(entity)) return;
+                if (tracked) changed_ticks[position(entity)] = tick;
+                record(Updated, entity);
+            }
+
+            //: tick filters, true if the component at a dense position was added or changed at or after the given tick
+            //      untracked pools always return true, and stamps equal to `since` are included so that a system that saves the tick
+            //      it ran at doesn't miss changes made later during that same tick
+            [[nodiscard]] constexpr bool added_since(const std::size_t pos, const Tick since) const noexcept {
+                return not tracked or added_ticks[pos] >= since;
+            }
+            [[nodiscard]] constexpr bool changed_since(const std::size_t pos, const Tick since) const noexcept {
+                return not tracked or changed_ticks[pos] >= since;
+            }
+
+            //: removed since
+            //      returns the entities removed from the pool at or after the given tick
+            [[nodiscard]] std::vector<EntityID> removed_since(const Tick since) const {
+                std::vector<EntityID> entities;
+                for (const auto& [entity, t] : removed_ticks) if (t >= since) entities.push_back(entity);
+                return entities;
+            }
+
+            //: trim
+            //      forgets the removals logged before the given tick, the log grows until it is trimmed
+            constexpr void trim(const Tick before) {
+                std::erase_if(removed_ticks, [&](const auto& r) { return r.second < before; });
+            }
+
+            //: dispatch
+            //      delivers the net changes since the last dispatch, with each entity at most once per event and sorted by index:
+            //      first the removed entities that are not in the pool anymore, then the added ones that still are, and last the updated
+            //      ones that still are and were not added. an entity that was removed and added again is only reported as added
+            //      the buffers are swapped before calling the observers, so the events they cause are delivered on the next dispatch
+            void dispatch() {
+                constexpr auto before = [](const EntityID a, const EntityID b) {
+                    return index(a).value < index(b).value or (index(a).value == index(b).value and version(a) < version(b));
+                };
+                std::swap(events, batch);
+                for (auto& b : batch) {
+                    if (not std::is_sorted(b.begin(), b.end(), before)) std::sort(b.begin(), b.end(), before);
+                    b.erase(std::unique(b.begin(), b.end()), b.end());
+                }
+                std::erase_if(batch[Removed], [&](const EntityID e) { return contains(e); });
+                std::erase_if(batch[Added], [&](const EntityID e) { return not contains(e); });
+                std::erase_if(batch[Updated], [&](const EntityID e) {
+                    return not contains(e) or std::binary_search(batch[Added].begin(), batch[Added].end(), e, before);
+                });
+                for (const auto e : {Removed, Added, Updated})
+                    if (not batch[e].empty()) for (auto& f : observers[e]) f(std::span<const EntityID>(batch[e]));
+                for (auto& b : batch) b.clear();
+            }
+
+            //* memory
+
+            //: memory
+            [[nodiscard]] PoolMemory memory() const {
+                std::size_t events_bytes = 0;
+                for (const auto& e : events) events_bytes += e.capacity() * sizeof(EntityID);
+                for (const auto& b : batch) events_bytes += b.capacity() * sizeof(EntityID);
+                return PoolMemory{
+                    .entities = size(),
+                    .sparse_pages = sparse.size(),
+                    .sparse_bytes = sparse.bytes(),
+                    .dense_size = dense.size(),
+                    .dense_capacity = dense.capacity(),
+                    .dense_bytes = dense.capacity() * sizeof(Index),
+                    .data_bytes = data_bytes(),
+                    .bookkeeping_bytes = (added_ticks.capacity() + changed_ticks.capacity()) * sizeof(Tick) +
+                                         removed_ticks.capacity() * sizeof(std::pair<EntityID, Tick>) + events_bytes,
+                };
+            }
+
+            //: compact
+            //      releases the sparse pages without entities and shrinks every array to its size, usually after removing many entities
+            //      paged storage keeps its components in place, but the other storages may move them, so references to components
+            //      are invalidated. it must not be called from an observer, since it releases the event buffers being delivered
+            void compact() {
+                sparse.compact(dense);
+                dense.shrink_to_fit();
+                added_ticks.shrink_to_fit();
+                changed_ticks.shrink_to_fit();
+                removed_ticks.shrink_to_fit();
+                for (auto& e : events) e.shrink_to_fit();
+                for (auto& b : batch) b.shrink_to_fit();
+                shrink_data();
+            }
+
+            //: remove, swap and store are constexpr virtual functions that are overriden by the derived classes
+            //      swap exchanges two positions of the dense array, updating the sparse array accordingly
+            //      store copies the current components into the previous buffer of a double buffered pool
             constexpr virtual void remove(const EntityID entity) = 0;
+            constexpr virtual void remove(std::span<const EntityID> entities) = 0;
+            constexpr virtual void swap(const std::size_t a, const std::size_t b) = 0;
+            constexpr virtual void store() = 0;
+
+            //: bytes allocated by the component storage and shrinking it, implemented by the typed pools
+            [[nodiscard]] virtual std::size_t data_bytes() const = 0;
+            virtual void shrink_data() = 0;
+        };
+
+        //: signature with the component ids of a list of pools, skipping the ones that don't have signatures
+        [[nodiscard]] inline Signature signature_of(std::initializer_list<const ComponentPoolBase*> pools) {
+            Signature mask;
+            for (auto pool : pools) if (pool->signatures != nullptr) mask.set(pool->component);
+            return mask;
+        }
+
+        //: base group
+        //      an owning group packs the entities that have all of its components at the front of every owned pool,
+        //      in the range [0, length) and in the same order, so they can be iterated as parallel arrays
+        //      pools notify their group when entities are added or removed so the packed range stays up to date
+        struct GroupBase {
+            //: owned pools and size of the packed range
+            std::vector<ComponentPoolBase*> owned;
+            std::size_t length = 0;
+
+            //: full ids (with their version) of the packed entities in order, so iterating doesn't look them up in the sparse array
+            std::vector<EntityID> entities;
+
+            //: type of the group, used to check if an existing group matches a request
+            TypeHash type;
+
+            //: constructor, takes ownership of the pools and packs the entities that are already in all of them
+            GroupBase(std::vector<ComponentPoolBase*> pools, TypeHash t) : owned(std::move(pools)), type(t) {
+                for (auto pool : owned) pool->group = this;
+                const auto smallest = *std::min_element(owned.begin(), owned.end(), [](auto a, auto b) { return a->size() < b->size(); });
+                for (std::size_t i = 0; i < smallest->size(); i++)
+                    add(smallest->entity_at(i));
+            }
+
+            //: destructor, releases the pools (they keep their current order)
+            virtual ~GroupBase() { for (auto pool : owned) pool->group = nullptr; }
+
+            //: add
+            //      called after an entity is added to an owned pool, if it now has all the components it is swapped into the packed range
+            constexpr void add(const EntityID entity) {
+                if (not std::all_of(owned.begin(), owned.end(), [&](auto pool) { return pool->contains(entity); })) return;
+                if (owned.front()->position(entity) < length) return;
+                for (auto pool : owned) pool->swap(pool->position(entity), length);
+                entities.push_back(entity);
+                length++;
+            }
+
+            //: remove
+            //      called before an entity is removed from an owned pool, if it is in the packed range it is swapped out of it
+            constexpr void remove(const ComponentPoolBase* pool, const EntityID entity) {
+                if (not pool->contains(entity) or pool->position(entity) >= length) return;
+                const auto pos = pool->position(entity);
+                length--;
+                for (auto p : owned) p->swap(p->position(entity), length);
+                entities[pos] = entities.back();
+                entities.pop_back();
+            }
+
+            //: clear, called when one of the pools is cleared
+            constexpr void clear() noexcept {
+                length = 0;
+                entities.clear();
+            }
+        };
+
+        //: base query
+        //      a cached query keeps a dense list of the entities that have all of its components, without owning or reordering the pools
+        //      positions maps each entity index to its place in the list (max_entities if it isn't there), and the pools notify
+        //      the query when entities are added or removed, so the list is always up to date and iterating it costs O(matches)
+        struct QueryBase {
+            //: pools, matching entities and their positions
+            std::vector<ComponentPoolBase*> pools;
+            std::vector<EntityID> entities;
+            std::vector<std::size_t> positions;
+
+            //: type of the query, used to find an existing one
+            TypeHash type;
+
+            //: constructor, registers in the pools and collects the entities that are already in all of them
+            QueryBase(std::vector<ComponentPoolBase*> p, TypeHash t) : pools(std::move(p)), type(t) {
+                for (auto pool : pools) pool->queries.push_back(this);
+                rebuild();
+            }
+
+            //: destructor, unregisters from the pools
+            virtual ~QueryBase() { for (auto pool : pools) std::erase(pool->queries, this); }
+
+            //: contains
+            [[nodiscard]] constexpr bool contains(const EntityID entity) const noexcept {
+                const std::size_t i = index(entity).value;
+                return i < positions.size() and positions[i] != max_entities and entities[positions[i]] == entity;
+            }
+
+            //: add
+            //      called after an entity is added to one of the pools, it is appended if it now has all the components
+            constexpr void add(const EntityID entity) {
+                if (contains(entity) or not std::all_of(pools.begin(), pools.end(), [&](auto pool) { return pool->contains(entity); })) return;
+                const std::size_t i = index(entity).value;
+                if (i >= positions.size()) positions.resize(i + 1, max_entities);
+                positions[i] = entities.size();
+                entities.push_back(entity);
+            }
+
+            //: remove
+            //      called before an entity is removed from one of the pools, the last match is moved into its place
+            constexpr void remove(const EntityID entity) {
+                if (not contains(entity)) return;
+                const std::size_t i = index(entity).value;
+                const auto last = entities.back();
+                entities[positions[i]] = last;
+                positions[index(last).value] = positions[i];
+                positions[i] = max_entities;
+                entities.pop_back();
+            }
+
+            //: clear, called when one of the pools is cleared
+            constexpr void clear() {
+                for (const auto entity : entities) positions[index(entity).value] = max_entities;
+                entities.clear();
+            }
+
+            //: rebuild the list from the smallest pool, for when the pools are modified without notifying the query
+            void rebuild() {
+                clear();
+                const auto smallest = *std::min_element(pools.begin(), pools.end(), [](auto a, auto b) { return a->size() < b->size(); });
+                for (std::size_t i = 0; i < smallest->size(); i++) add(smallest->entity_at(i));
+            }
         };
     }
 
+    namespace detail
+    {
+        //: radix sort
+        //      stable least significant digit sort of (key, position) pairs by an unsigned key, one byte per pass
+        //      the histograms of every pass are built in a single read, and passes where every key has the same byte are skipped,
+        //      so small keys only pay for the bytes they use
+        template <std::unsigned_integral K, std::unsigned_integral P>
+        void radix_sort(std::vector<std::pair<K, P>>& items) {
+            constexpr std::size_t passes = sizeof(K);
+            std::array<std::array<std::size_t, 256>, passes> count = {};
+            for (const auto& item : items)
+                for (std::size_t p = 0; p < passes; p++) count[p][(item.first >> (p * 8)) & 0xff]++;
+
+            std::vector<std::pair<K, P>> buffer(items.size());
+            for (std::size_t p = 0; p < passes; p++) {
+                auto& c = count[p];
+                if (std::find(c.begin(), c.end(), items.size()) != c.end()) continue;
+                for (std::size_t i = 0, sum = 0; i < 256; i++) { const auto x = c[i]; c[i] = sum; sum += x; }
+                for (const auto& item : items) buffer[c[(item.first >> (p * 8)) & 0xff]++] = item;
+                items.swap(buffer);
+            }
+        }
+    }
+
+    namespace detail
+    {
+        //: storage used by a component pool
+        template <typename T>
+        using Storage = std::conditional_t<concepts::TagComponent<T>, TagVector<T>,
+                        std::conditional_t<concepts::SoAComponent<T>, SoAVector<T>,
+                        std::conditional_t<concepts::PagedComponent<T>, PagedVector<T>,
+                        std::vector<T, typename allocator_of<T, std::allocator<T>>::type>>>>;
+
+        //: empty storage, using the allocator of the component
+        template <typename T>
+        [[nodiscard]] Storage<T> make_storage() {
+            static_assert(not (concepts::SoAComponent<T> and concepts::PagedComponent<T>), "a component can't use both soa and paged storage");
+            if constexpr (not concepts::TagComponent<T> and not concepts::SoAComponent<T> and not concepts::PagedComponent<T>)
+                return Storage<T>(make_allocator<typename Storage<T>::allocator_type, T>());
+            else
+                return Storage<T>();
+        }
+
+        //: pointer to an element of a vector
+        template <typename T, typename A>
+        [[nodiscard]] constexpr T* address(std::vector<T, A>& v, const std::size_t i) noexcept { return &v[i]; }
+
+        //: bytes allocated by a vector
+        template <typename T, typename A>
+        [[nodiscard]] constexpr std::size_t allocated_bytes(const std::vector<T, A>& v) noexcept { return v.capacity() * sizeof(T); }
+
+        //: reserve room for n more elements keeping the geometric growth, an exact reserve on every batch would copy the whole array each time
+        template <typename V>
+        constexpr void reserve_more(V& v, const std::size_t n) {
+            if (v.capacity() < v.size() + n) v.reserve(std::max(v.size() + n, 2 * v.capacity()));
+        }
+    }
+
+    //: interpolation trait, used by double buffered pools to blend the previous and current state of a component
+    //      floating point types and types with + and scalar * (like the math vectors) work by default, specialize it with a static lerp otherwise
+    //          template <> struct fresa::ecs::Interpolate<Transform> { static Transform lerp(const Transform& a, const Transform& b, float t); };
+    template <typename T>
+    struct Interpolate {
+        [[nodiscard]] static constexpr T lerp(const T& a, const T& b, const float t) requires requires { a + (b - a) * t; } {
+            if constexpr (std::floating_point<T>) return interpolate(a, b, T(t));
+            else return static_cast<T>(a + (b - a) * t);
+        }
+    };
+
+    namespace concepts
+    {
+        template <typename T>
+        concept Interpolable = requires (const T& a, const T& b, float t) { { Interpolate<T>::lerp(a, b, t) } -> std::convertible_to<T>; };
+    }
+
     //: typed component pool
+    //      components are stored in a std::vector<T>, as a structure of arrays if they specialize ecs::SoA (see ecs_soa.h),
+    //      or in pages that never move if they specialize ecs::Paged, all using the allocator of ecs::Allocator<T> (see ecs_storage.h)
+    //      empty components are tags and only count their elements, which are all the same instance
+    //      reference and pointer are T& and T* for regular, paged and tag components and proxies for soa components
     template <typename T>
     struct ComponentPool : detail::ComponentPoolBase {
         //: data
-        std::vector<T> data;
+        detail::Storage<T> data = detail::make_storage<T>();
+
+        //: double buffering, disabled by default (see buffer())
+        //      previous runs parallel to the data array and holds the components as they were on the last store(), new components
+        //      start with the same value in both, and removals and swaps are mirrored so each entity keeps its previous value
+        bool buffered = false;
+        detail::Storage<T> previous = detail::make_storage<T>();
+
+        //: element types
+        using reference = decltype(std::declval<detail::Storage<T>&>()[0]);
+        using pointer = decltype(detail::address(std::declval<detail::Storage<T>&>(), 0));
 
         //: add
         //      adds an entity to the sparse array, if there is an entity with a lower version it is updated
         //      if the entity has the same or higher version, an error is thrown
         constexpr void add(const EntityID entity, T&& value) {
-            const auto pos = index(entity).value;
-            const auto page = pos / engine_config.ecs_page_size();
-
-            if (not sparse.contains(page))
-                sparse[page].fill(invalid_id);
-
-            auto& element = *sparse_at(pos);
+            const std::size_t pos = index(entity).value;
+            auto& element = sparse.assure(pos / detail::SparseArray::page_size)[pos % detail::SparseArray::page_size];
             if (element == invalid_id) {
                 element = id(dense.size(), version(entity));
+                if (buffered) previous.emplace_back(value);
                 data.emplace_back(std::move(value));
                 dense.emplace_back(index(entity));
+                if (tracked) { added_ticks.push_back(tick); changed_ticks.push_back(tick); }
+                sign(pos);
             } else if (version(entity) > version(element)) {
-                element = id(index(element), version(entity));
-                data.at(index(element).value) = std::move(value);
-                dense.at(index(element).value) = index(entity);
+                if (group) group->remove(this, id(index(entity), version(element)));
+                for (auto q : queries) q->remove(id(index(entity), version(element)));
+                if (tracked) removed_ticks.emplace_back(id(index(entity), version(element)), tick);
+                record(Removed, id(index(entity), version(element)));
+                auto& updated = *sparse_at(entity);
+                updated = id(index(updated), version(entity));
+                if (buffered) previous.at(index(updated).value) = value;
+                data.at(index(updated).value) = std::move(value);
+                dense.at(index(updated).value) = index(entity);
+                if (tracked) added_ticks.at(index(updated).value) = changed_ticks.at(index(updated).value) = tick;
             } else {
                 log::error("entity {} with version {} already exists in sparse set", entity.value, version(entity).value);
+                return;
             }
+            if (group) group->add(entity);
+            for (auto q : queries) q->add(entity);
+            record(Added, entity);
+        }
+
+        //: add multiple
+        //      adds a copy of the same value to a list of entities, reserving the storage once (growing geometrically)
+        //      new entities are appended in a single pass, while entities already in the pool go through the regular add
+        constexpr void add(std::span<const EntityID> entities, const T& value) {
+            detail::reserve_more(dense, entities.size());
+            detail::reserve_more(data, entities.size());
+
+            const auto first = dense.size();
+            std::vector<EntityID> existing;
+            for (const auto entity : entities) {
+                const std::size_t pos = index(entity).value;
+                auto& element = sparse.assure(pos / detail::SparseArray::page_size)[pos % detail::SparseArray::page_size];
+                if (element != invalid_id) { existing.push_back(entity); continue; }
+                element = id(dense.size(), version(entity));
+                dense.emplace_back(index(entity));
+                sign(pos);
+            }
+            data.resize(dense.size(), value);
+            if (buffered) previous.resize(dense.size(), value);
+            if (tracked) { added_ticks.resize(dense.size(), tick); changed_ticks.resize(dense.size(), tick); }
+
+            if (group)
+                for (std::size_t i = first; i < dense.size(); i++) group->add(entity_at(i));
+            for (auto q : queries)
+                for (std::size_t i = first; i < dense.size(); i++) q->add(entity_at(i));
+            if (not observers[Added].empty())
+                for (std::size_t i = first; i < dense.size(); i++) events[Added].push_back(entity_at(i));
+            for (const auto entity : existing) add(entity, T(value));
         }
 
         //: get
         //      returns a pointer to the entity value from the dense array if it exists, if not it returns nullptr
-        [[nodiscard]] constexpr const T* get(const EntityID entity) {
+        [[nodiscard]] constexpr auto get(const EntityID entity) {
+            using const_pointer = std::conditional_t<std::is_pointer_v<pointer>, const T*, pointer>;
+            const auto sid = sparse_at(entity);
+            return valid(sid, version(entity)) ? const_pointer(detail::address(data, index(*sid).value)) : const_pointer{};
+        }
+
+        //: at
+        //      returns a reference to the entity value without checking, the entity must be contained in the pool
+        [[nodiscard]] constexpr reference at(const EntityID entity) {
+            return data[index(*sparse_at(entity)).value];
+        }
+
+        //: patch
+        //      returns a pointer to the entity value to modify it, marking it as changed if the pool is tracked, or nullptr if it doesn't exist
+        [[nodiscard]] constexpr pointer patch(const EntityID entity) {
             const auto sid = sparse_at(entity);
-            return valid(sid, version(entity)) ? &data.at(index(*sid).value) : nullptr;
+            if (not valid(sid, version(entity))) return pointer{};
+            if (tracked) changed_ticks[index(*sid).value] = tick;
+            record(Updated, entity);
+            return detail::address(data, index(*sid).value);
         }
 
         //: remove
         //      removes an entity if it exists, otherwise it does nothing
-        //      it swaps the last element with the removed element from both the sparse and dense arrays
-        //      this function uses find if to find the last entity, however, it might be faster to use a dedicated extra array that holds
-        //      the references to the entities from each spot of the dense array
+        //      it swaps the removed element with the last one from both the sparse and dense arrays and then pops it
+        //      if the pool is owned by a group, the entity is first taken out of the packed range of the group, and out of the cached queries
         constexpr void remove(const EntityID entity) override {
-            const auto sid = sparse_at(entity);
-            if (not valid(sid, version(entity))) return;
-
-            SparseID* last_sparse = sparse_at(dense.back().value);
-            auto removed_element = sparse_at(index(entity).value);
+            if (not contains(entity)) return;
+            if (group) group->remove(this, entity);
+            for (auto q : queries) q->remove(entity);
+            record(Removed, entity);
 
-            std::swap(*last_sparse, *removed_element);
-            std::swap(dense.back(), dense.at(index(*last_sparse).value));
-            std::swap(data.back(), data.at(index(*last_sparse).value));
-
-            *removed_element = invalid_id;
+            swap(position(entity), dense.size() - 1);
+            *sparse_at(entity) = invalid_id;
+            unsign(index(entity).value);
             data.pop_back();
+            if (buffered) previous.pop_back();
             dense.pop_back();
+            if (tracked) { added_ticks.pop_back(); changed_ticks.pop_back(); removed_ticks.emplace_back(entity, tick); }
+        }
+
+        //: remove multiple
+        //      convenience overload that removes the entities one by one, each removal is already a constant time swap and pop
+        constexpr void remove(std::span<const EntityID> entities) override {
+            for (const auto entity : entities) ComponentPool::remove(entity);
+        }
+
+        //: swap
+        //      exchanges two positions of the dense and data arrays, the sparse array keeps the version of each entity
+        constexpr void swap(const std::size_t a, const std::size_t b) override {
+            if (a == b) return;
+            auto& sa = *sparse_at(dense[a].value);
+            auto& sb = *sparse_at(dense[b].value);
+            sa = id(b, version(sa));
+            sb = id(a, version(sb));
+            std::swap(dense[a], dense[b]);
+            if constexpr (not concepts::TagComponent<T>) {
+                using std::swap;
+                swap(data[a], data[b]);
+                if (buffered) swap(previous[a], previous[b]);
+            }
+            if (tracked) { std::swap(added_ticks[a], added_ticks[b]); std::swap(changed_ticks[a], changed_ticks[b]); }
+        }
+
+        //* double buffering
+        //      a buffered pool keeps the state of its components from the previous simulation step, so rendering can interpolate
+        //      between the two states when it runs at a different rate than the simulation
+
+        //: buffer
+        //      enables double buffering for this pool, the previous state starts as a copy of the current one
+        constexpr void buffer() {
+            if (buffered) return;
+            buffered = true;
+            previous = data;
+        }
+
+        //: store
+        //      copies the current state into the previous buffer, which has the same size so this is a single pass without allocations
+        constexpr void store() override {
+            if (not buffered) return;
+            if constexpr (concepts::PagedComponent<T>) std::copy(data.begin(), data.end(), previous.begin());
+            else previous = data;
+        }
+
+        //: interpolated
+        //      blends the previous and current state of a component with a factor between 0 (previous) and 1 (current),
+        //      the entity must be contained in the pool, and pools that are not buffered return the current state
+        [[nodiscard]] constexpr T interpolated(const EntityID entity, const float alpha) requires concepts::Interpolable<T> {
+            const auto i = position(entity);
+            return buffered ? T(Interpolate<T>::lerp(T(previous[i]), T(data[i]), alpha)) : T(data[i]);
+        }
+
+        //* sort
+        //      reorders the dense array so that iterating the pool follows a logical or spatial order instead of insertion order
+        //      the data, dense and sparse arrays (and the change ticks) are permuted together, so entity ids stay valid
+        //      pools owned by a group keep the order of the group and can't be sorted
+
+        //: sort with a comparator between two components
+        template <typename Compare> requires std::predicate<Compare, const T&, const T&>
+        void sort(Compare compare) {
+            std::vector<std::size_t> order(size());
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return compare(data[a], data[b]); });
+            permute(std::move(order));
+        }
+
+        //: sort by an integral key of each component, using a radix sort
+        template <typename Key> requires std::integral<std::invoke_result_t<Key, const T&>>
+        void sort_by(Key key) {
+            using K = std::invoke_result_t<Key, const T&>;
+            using U = std::make_unsigned_t<K>;
+            using P = detail::uint_fit<detail::index_bits>;
+            std::vector<std::pair<U, P>> items(size());
+            for (std::size_t i = 0; i < size(); i++) {
+                //: flipping the sign bit makes signed keys sort correctly as unsigned
+                const auto k = static_cast<U>(key(data[i]));
+                items[i] = {std::is_signed_v<K> ? U(k ^ (U(1) << (sizeof(U) * 8 - 1))) : k, P(i)};
+            }
+            detail::radix_sort(items);
+            std::vector<std::size_t> order(size());
+            for (std::size_t i = 0; i < size(); i++) order[i] = items[i].second;
+            permute(std::move(order));
+        }
+
+        //: sort as another pool
+        //      entities that are also in the other pool are moved to the front in the same order they have there,
+        //      and the rest are kept after them in their current order
+        void sort_as(const detail::ComponentPoolBase& other) {
+            std::vector<std::size_t> order;
+            order.reserve(size());
+            std::vector<bool> placed(size(), false);
+            for (std::size_t i = 0; i < other.size(); i++) {
+                const auto entity = other.entity_at(i);
+                if (not contains(entity)) continue;
+                order.push_back(position(entity));
+                placed[order.back()] = true;
+            }
+            for (std::size_t i = 0; i < size(); i++) if (not placed[i]) order.push_back(i);
+            permute(std::move(order));
+        }
+
+        //: permute
+        //      moves the element at position order[i] to position i for every i, following the cycles of the permutation with swaps
+        void permute(std::vector<std::size_t> order) {
+            if (group) { log::error("can't sort {}, the pool is owned by a group", type_name<T>()); return; }
+            for (std::size_t i = 0; i < order.size(); i++) {
+                std::size_t current = i, next = order[i];
+                while (next != i) {
+                    ComponentPool::swap(current, next);
+                    order[current] = current;
+                    current = next;
+                    next = order[next];
+                }
+                order[current] = current;
+            }
         }
 
         //: clear
         constexpr void clear() {
             log::info("clearing {}", type_name<T>());
+            if (not observers[Removed].empty())
+                for (std::size_t i = 0; i < size(); i++) events[Removed].push_back(entity_at(i));
+            for (const auto i : dense) unsign(i.value);
             sparse.clear();
+            dense.clear();
             data.clear();
+            previous.clear();
+            added_ticks.clear();
+            changed_ticks.clear();
+            if (group) group->clear();
+            for (auto q : queries) q->clear();
         }
 
-        //: size and extent
-        [[nodiscard]] constexpr std::size_t size() const { return dense.size(); }
-        [[nodiscard]] constexpr std::size_t extent() const { return sparse.size() * engine_config.ecs_page_size(); }
+        //: extent
+        [[nodiscard]] constexpr std::size_t extent() const { return sparse.size() * detail::SparseArray::page_size; }
+
+        //: storage memory and shrinking, the previous buffer of double buffered pools included
+        [[nodiscard]] std::size_t data_bytes() const override { return detail::allocated_bytes(data) + detail::allocated_bytes(previous); }
+        void shrink_data() override {
+            data.shrink_to_fit();
+            previous.shrink_to_fit();
+        }
 
         //: iterators
         //- add support for dense entity iterators
@@ -170,108 +902,680 @@ namespace fresa::ecs
         [[nodiscard]] constexpr auto crend() const noexcept { return data.crend(); }
     };
 
+    //: reference to a component as passed to views and groups, T& or a proxy for soa components
+    template <typename T>
+    using ComponentRef = typename ComponentPool<T>::reference;
+
+    namespace detail
+    {
+        //: components yielded by views, groups and queries, tags are skipped since they don't hold any data
+        template <typename T>
+        struct yielded { using type = std::tuple<ComponentRef<T>>; };
+        template <concepts::TagComponent T>
+        struct yielded<T> { using type = std::tuple<>; };
+        template <typename ... C>
+        using yielded_t = decltype(std::tuple_cat(std::declval<typename yielded<C>::type>()...));
+
+        //: yields the reference returned by get, or nothing without calling it for tags
+        template <typename T, typename G>
+        [[nodiscard]] constexpr typename yielded<T>::type yield(G&& get) {
+            if constexpr (concepts::TagComponent<T>) return {};
+            else return typename yielded<T>::type{get()};
+        }
+
+        template <typename F, typename Tuple>
+        struct invocable_with : std::false_type {};
+        template <typename F, typename ... R>
+        struct invocable_with<F, std::tuple<R...>> : std::bool_constant<std::invocable<F, EntityID, R...>> {};
+    }
+
+    namespace concepts
+    {
+        //: function called with an entity and the components of C... that are not tags
+        template <typename F, typename ... C>
+        concept EachFunction = detail::invocable_with<F, detail::yielded_t<C...>>::value;
+    }
+
+    //* group
+    //      owning group of components, created with Scene::group<C...>()
+    //      iterating a group is a linear walk over the packed range of its pools, without any sparse lookups
+    template <typename ... C> requires (sizeof...(C) > 1)
+    struct Group : detail::GroupBase {
+        //: typed pools
+        std::tuple<ComponentPool<C>*...> pools;
+
+        //: constructor
+        Group(ComponentPool<C>& ... p) : GroupBase({&p...}, type_hash<Group<C...>>()), pools{&p...} {}
+
+        //: number of entities in the group
+        [[nodiscard]] constexpr std::size_t size() const noexcept { return length; }
+
+        //: each
+        //      calls f(entity, components...) for every entity in the group, in the same order for all the pools
+        template <typename F> requires concepts::EachFunction<F, C...>
+        constexpr void each(F&& f) {
+            for (std::size_t i = 0; i < length; i++) {
+                if constexpr (not (concepts::TagComponent<C> or ...)) f(entities[i], std::get<ComponentPool<C>*>(pools)->data[i]...);
+                else std::apply([&](auto&& ... c) { f(entities[i], std::forward<decltype(c)>(c)...); },
+                                std::tuple_cat(detail::yield<C>([&]() -> ComponentRef<C> { return std::get<ComponentPool<C>*>(pools)->data[i]; })...));
+            }
+        }
+    };
+
+    //* query
+    //      cached query of components, created with Scene::query<C...>()
+    //      unlike a view it doesn't search the pools on every walk, it iterates the list of matching entities that it keeps up to date,
+    //      so a rare combination of components costs as much as its number of matches. unlike a group it doesn't own the pools,
+    //      so any number of queries can share them, but each component is accessed through the sparse array of its pool
+    //      adding or removing components while iterating a query can reorder its list, record them in a command buffer instead
+    template <typename ... C> requires (sizeof...(C) > 0)
+    struct Query : detail::QueryBase {
+        //: typed pools
+        std::tuple<ComponentPool<C>*...> typed;
+
+        //: constructor
+        Query(ComponentPool<C>& ... p) : QueryBase({&p...}, type_hash<Query<C...>>()), typed{&p...} {}
+
+        //: number of matching entities
+        [[nodiscard]] constexpr std::size_t size() const noexcept { return entities.size(); }
+
+        //: each
+        //      calls f(entity, components...) for every matching entity
+        template <typename F> requires concepts::EachFunction<F, C...>
+        constexpr void each(F&& f) {
+            for (std::size_t i = 0; i < entities.size(); i++) {
+                if constexpr (not (concepts::TagComponent<C> or ...)) f(entities[i], std::get<ComponentPool<C>*>(typed)->at(entities[i])...);
+                else std::apply([&](auto&& ... c) { f(entities[i], std::forward<decltype(c)>(c)...); },
+                                std::tuple_cat(detail::yield<C>([&]() -> ComponentRef<C> { return std::get<ComponentPool<C>*>(typed)->at(entities[i]); })...));
+            }
+        }
+
+        //: iterators over the matching entities
+        [[nodiscard]] constexpr auto begin() const noexcept { return entities.begin(); }
+        [[nodiscard]] constexpr auto end() const noexcept { return entities.end(); }
+    };
+
     //---
 
     //* scene
     //-     ...
     struct Scene {
         //* component pool
-        //      searchs the hash map for the specified component type
-        //      if none is found, create it. this operation is thread safe
+        //      pools are found with the dense component id of their type, which indexes an array of atomic pointers,
+        //      so getting an existing pool is a single load without locks or hashing
+        //      only creating a pool takes the lock, and it publishes the pointer once the pool is ready. this operation is thread safe
+        //      types past ecs_max_components() don't have an id and are searched in the hash map under the lock
 
-        //: hash map of component pools, using the component type as a key
+        //: hash map of component pools, using the component type as a key, it owns every pool of the scene
         std::unordered_map<TypeHash, std::unique_ptr<detail::ComponentPoolBase>> component_pools;
 
+        //: current tick, used to stamp changes in tracked pools
+        Tick tick = 1;
+
+        //: signature of each entity index, pools indexed by their component id and pools without an id
+        std::vector<detail::Signature> signatures;
+        std::array<std::atomic<detail::ComponentPoolBase*>, detail::max_components> indexed_pools = {};
+        std::vector<detail::ComponentPoolBase*> unindexed_pools;
+
         //: this mutex prevents the creation of multiple component pools of the same type
         std::mutex component_pool_create_mutex;
 
         //: get component pool
         template <typename C>
         auto& cpool() {
+            const auto c = detail::component_id<C>();
+
+            //: fast path, the pool already exists
+            if (c < detail::max_components)
+                if (auto pool = indexed_pools[c].load(std::memory_order_acquire))
+                    return static_cast<ComponentPool<C>&>(*pool);
+
             constexpr TypeHash t = type_hash<C>();
             std::lock_guard<std::mutex> lock(component_pool_create_mutex);
 
-            //: find the pool using the type hash
+            //: find the pool using the type hash, another thread may have created it while waiting for the lock
             auto it = component_pools.find(t);
 
             //: there is no pool, create it
             if (it == component_pools.end()) {
                 auto pool = std::make_unique<ComponentPool<C>>();
+                pool->tick = tick;
+                if (c < detail::max_components) {
+                    pool->signatures = &signatures;
+                    pool->component = c;
+                } else {
+                    log::warn("{} has no signature bit, increase ecs_max_components() to more than {}", type_name<C>(), detail::max_components);
+                    unindexed_pools.push_back(pool.get());
+                }
                 it = component_pools.emplace(t, std::move(pool)).first;
+                if (c < detail::max_components) indexed_pools[c].store(it->second.get(), std::memory_order_release);
             }
 
             //: return a reference to the pool
-            return (ComponentPool<C>&)(*it->second);
+            return static_cast<ComponentPool<C>&>(*it->second);
         }
         template <typename C>
         const auto& cpool() const { return const_cast<Scene*>(this)->cpool<C>(); }
 
         // ---
 
+        //* change tracking
+        //      tracked pools stamp every component with the tick at which it was added and last changed, and log removals,
+        //      so incremental systems can use View::added and View::changed, or removed_since, to skip everything else
+        //          const auto since = last_run; last_run = scene.tick;
+        //          View<Transform>(scene).changed<Transform>(since).each(...);
+        //      modifying a component through a reference doesn't mark it, use patch() or touch() for that
+
+        //: enable change tracking for a component
+        template <typename C>
+        void track() { cpool<C>().track(); }
+
+        //: advance the tick, usually once per frame, and return the new one
+        Tick advance() {
+            tick++;
+            for (auto& [key, pool] : component_pools) pool->tick = tick;
+            return tick;
+        }
+
+        //: get a component to modify it, marking it as changed
+        template <typename C>
+        [[nodiscard]] constexpr auto patch(const EntityID entity) { return cpool<C>().patch(entity); }
+
+        // ---
+
+        //* observers
+        //      observers are called with the entities that had a component added, removed or updated (with patch() or touch()),
+        //      all at once at a sync point instead of on every operation, so dependent structures catch up in a single pass
+        //          scene.on_remove<Agent>([&](std::span<const ecs::EntityID> removed) { for (auto e : removed) ... });
+        //          scene.dispatch();                   // once per frame
+        //      pools only record the kinds of events that have observers, and loading a snapshot doesn't record any
+        //      patching an observed component appends to a shared buffer, so it must not be done from concurrent jobs
+
+        std::vector<detail::ComponentPoolBase*> observed_pools;
+
+        //: register observers
+        template <typename C, typename F> requires std::invocable<F, std::span<const EntityID>>
+        void on_add(F&& f) { observe<C>(detail::ComponentPoolBase::Added, std::forward<F>(f)); }
+        template <typename C, typename F> requires std::invocable<F, std::span<const EntityID>>
+        void on_remove(F&& f) { observe<C>(detail::ComponentPoolBase::Removed, std::forward<F>(f)); }
+        template <typename C, typename F> requires std::invocable<F, std::span<const EntityID>>
+        void on_update(F&& f) { observe<C>(detail::ComponentPoolBase::Updated, std::forward<F>(f)); }
+
+        template <typename C, typename F>
+        void observe(const detail::ComponentPoolBase::Event e, F&& f) {
+            auto& pool = cpool<C>();
+            if (std::find(observed_pools.begin(), observed_pools.end(), &pool) == observed_pools.end()) observed_pools.push_back(&pool);
+            pool.observers[e].emplace_back(std::forward<F>(f));
+        }
+
+        //: remove every observer of a component, discarding its pending events
+        template <typename C>
+        void clear_observers() {
+            auto& pool = cpool<C>();
+            for (auto& o : pool.observers) o.clear();
+            for (auto& e : pool.events) e.clear();
+            std::erase(observed_pools, &pool);
+        }
+
+        //: deliver the events recorded since the last dispatch, pool by pool in the order their first observer was registered
+        //      observers can modify the scene, but not register or remove other observers
+        void dispatch() {
+            for (auto pool : observed_pools) pool->dispatch();
+        }
+
+        // ---
+
+        //* interpolation
+        //      buffered pools keep the state of the previous simulation step, so a renderer running between two steps can draw
+        //      the components blended with the interpolation_alpha computed by the engine update loop, store() is usually
+        //      registered as the first exclusive system of ecs::schedule so it runs on every step (see docs/reference/time.md)
+        //          scene.store();                      // at the start of each simulation step, the engine doesn't call it
+        //          Interpolated<Transform>(scene, (float)interpolation_alpha).each(...);
+
+        std::vector<detail::ComponentPoolBase*> buffered_pools;
+
+        //: enable double buffering for a component
+        template <typename C>
+        void buffer() {
+            auto& pool = cpool<C>();
+            if (pool.buffered) return;
+            pool.buffer();
+            buffered_pools.push_back(&pool);
+        }
+
+        //: copy the current state of every buffered pool into its previous buffer
+        void store() {
+            for (auto pool : buffered_pools) pool->store();
+        }
+
+        //: interpolated component of an entity, which must have it
+        template <typename C> requires concepts::Interpolable<C>
+        [[nodiscard]] C interpolated(const EntityID entity, const float alpha) { return cpool<C>().interpolated(entity, alpha); }
+
+        // ---
+
+        //* groups
+        //      a pool can only be owned by one group, so creating a group with a pool that already belongs to a different group
+        //      destroys the previous group, invalidating references to it
+
+        std::vector<std::unique_ptr<detail::GroupBase>> groups;
+
+        //: get or create group
+        template <typename ... C> requires (sizeof...(C) > 1)
+        auto& group() {
+            constexpr TypeHash t = type_hash<Group<C...>>();
+            const std::array<detail::ComponentPoolBase*, sizeof...(C)> pools = {&cpool<C>()...};
+
+            //: the group already exists
+            if (pools.front()->group != nullptr and pools.front()->group->type == t)
+                return static_cast<Group<C...>&>(*pools.front()->group);
+
+            //: remove conflicting groups
+            std::erase_if(groups, [&](const auto& g) {
+                if (std::none_of(pools.begin(), pools.end(), [&](auto p) { return p->group == g.get(); })) return false;
+                log::warn("component pool already owned by another group, the previous group will be destroyed");
+                return true;
+            });
+
+            groups.push_back(std::make_unique<Group<C...>>(cpool<C>()...));
+            return static_cast<Group<C...>&>(*groups.back());
+        }
+
+        // ---
+
+        //* queries
+        //      queries are registered on the scene and live as long as it does, or until they are dropped
+
+        std::vector<std::unique_ptr<detail::QueryBase>> queries;
+
+        //: get or create query
+        template <typename ... C> requires (sizeof...(C) > 0)
+        auto& query() {
+            constexpr TypeHash t = type_hash<Query<C...>>();
+            for (auto& q : queries) if (q->type == t) return static_cast<Query<C...>&>(*q);
+            queries.push_back(std::make_unique<Query<C...>>(cpool<C>()...));
+            return static_cast<Query<C...>&>(*queries.back());
+        }
+
+        //: drop a query, so its pools stop updating it
+        template <typename ... C> requires (sizeof...(C) > 0)
+        void drop_query() {
+            constexpr TypeHash t = type_hash<Query<C...>>();
+            std::erase_if(queries, [&](const auto& q) { return q->type == t; });
+        }
+
+        // ---
+
+        //* memory
+        //      pools report the memory they hold with cpool<C>().memory(), and compact() gives back what the scene doesn't use anymore,
+        //      so a long running scene doesn't keep the memory of its largest wave of entities. it invalidates references to components
+
+        //: memory of all the pools of the scene
+        [[nodiscard]] PoolMemory memory() const {
+            PoolMemory total;
+            for (const auto& [key, pool] : component_pools) total += pool->memory();
+            return total;
+        }
+
+        //: compact every pool, and release the signatures past the last entity with components and the space of groups and cached queries
+        void compact() {
+            for (auto& [key, pool] : component_pools) pool->compact();
+            while (not signatures.empty() and signatures.back().none()) signatures.pop_back();
+            signatures.shrink_to_fit();
+            for (auto& g : groups) g->entities.shrink_to_fit();
+            for (auto& q : queries) q->entities.shrink_to_fit();
+        }
+
+        // ---
+
         //* entities
-        //-     ...
+        //      every entity index that has been used has a slot in the entities array. alive slots hold their own entity id,
+        //      while free slots form an implicit linked list through their index field, which stores the index of the next free slot,
+        //      and keep the version that the index will have when it is recycled. free_list is the first free slot, or max_entities if none
+        //      creating and destroying entities doesn't allocate (besides growing the array), and valid() is a single comparison
+
+        std::vector<EntityID> entities;
+        std::size_t free_list = max_entities;
+
+        //: number of fresh ids handed out by reserve() that are not yet in the entities array
+        std::atomic<std::size_t> reserved = 0;
+
+        //: is valid
+        //      checks if the entity is alive, ids of removed entities are invalid since their slot has a newer version
+        [[nodiscard]] constexpr bool valid(const EntityID entity) const noexcept {
+            const std::size_t i = index(entity).value;
+            return i < entities.size() and entities[i] == entity;
+        }
 
-        std::deque<EntityID> free_entities = {ecs::id(0, 0)};
+        //: reserve entity
+        //      returns a fresh id after the last used index without modifying the entities array, so it is safe to call from several threads
+        //      the entity has no components until some are added, and the id is committed the next time the scene adds entities
+        //      recycled ids are not used, and other structural changes must not happen while ids are being reserved
+        [[nodiscard]] EntityID reserve() {
+            const std::size_t i = entities.size() + reserved.fetch_add(1);
+            if (i >= max_entities) {
+                log::error("the scene is full, increase ecs_index_bits() to hold more than {} entities", max_entities);
+                return invalid_id;
+            }
+            return id(i, 0);
+        }
+
+        //: commit reserved ids, adding their slots to the entities array
+        void commit_reserved() {
+            if (reserved.load(std::memory_order_relaxed) == 0) return;
+            const auto n = reserved.exchange(0);
+            for (std::size_t i = entities.size(), end = std::min(i + n, max_entities); i < end; i++) entities.push_back(id(i, 0));
+        }
 
         //: add entity
+        //      recycles the first free slot if there is one, otherwise appends a new slot
         template <typename ... C>
         constexpr const EntityID add(C&& ... components) {
-            const auto entity = free_entities.front();
-            if (free_entities.size() > 1) free_entities.pop_front();
-            else free_entities.back() = entity.value + 1;
+            commit_reserved();
+            EntityID entity;
+            if (free_list != max_entities) {
+                const auto i = free_list;
+                free_list = index(entities[i]).value;
+                entity = entities[i] = id(i, version(entities[i]));
+            } else if (entities.size() < max_entities) {
+                entity = entities.emplace_back(id(entities.size(), 0));
+            } else {
+                log::error("the scene is full, increase ecs_index_bits() to hold more than {} entities", max_entities);
+                return invalid_id;
+            }
             (cpool<C>().add(entity, std::forward<C>(components)), ...);
             return entity;
         }
 
+        //: add multiple entities
+        //      creates count entities with a copy of the same components, returning their ids
+        //      new ids are taken as a contiguous run after the last used index, and each pool is looked up and filled only once
+        template <typename ... C>
+        std::vector<EntityID> add_n(const std::size_t count, const C& ... components) {
+            commit_reserved();
+            const std::size_t first = entities.size();
+            if (first + count > max_entities) {
+                log::error("the scene is full, increase ecs_index_bits() to hold more than {} entities", max_entities);
+                return {};
+            }
+
+            std::vector<EntityID> created(count);
+            for (std::size_t i = 0; i < count; i++) created[i] = id(first + i, 0);
+            entities.insert(entities.end(), created.begin(), created.end());
+
+            (cpool<C>().add(created, components), ...);
+            return created;
+        }
+
+        //: release slot
+        //      links the slot of an entity at the front of the free list and bumps its version
+        constexpr void release(const EntityID entity) {
+            const std::size_t i = index(entity).value;
+            entities[i] = id(free_list, version(entity) + Version(1));
+            free_list = i;
+        }
+
         //: get entity component
         template <typename C>
-        [[nodiscard]] constexpr const C* get(const EntityID entity) {
+        [[nodiscard]] constexpr auto get(const EntityID entity) {
             return cpool<C>().get(entity);
         }
 
+        //: signature of an entity index, empty if it has no components
+        [[nodiscard]] detail::Signature signature(const EntityID entity) const {
+            const std::size_t i = index(entity).value;
+            return i < signatures.size() ? signatures[i] : detail::Signature{};
+        }
+
+        //: has components
+        //      checks if the entity has all the components, the signature rejects most entities without looking at the pools
+        template <typename ... C>
+        [[nodiscard]] bool has(const EntityID entity) {
+            const auto mask = detail::signature_of({&cpool<C>()...});
+            return signature(entity).contains(mask) and (cpool<C>().contains(entity) and ...);
+        }
+
         //: remove entity
+        //      only the pools in the signature of the entity are visited, entities that are not alive are ignored
         constexpr void remove(const EntityID entity) {
-            [&] { for (auto &[key, pool] : component_pools) pool->remove(entity); }();
-            free_entities.push_front(id(index(entity), version(entity) + Version(1)));
+            if (not valid(entity)) return;
+            signature(entity).each([&](ui32 c) { indexed_pools[c].load(std::memory_order_relaxed)->remove(entity); });
+            for (auto pool : unindexed_pools) pool->remove(entity);
+            release(entity);
+        }
+
+        //: remove multiple entities
+        //      each pool that any of the entities has is visited once for the whole range instead of once per entity
+        //      entities that are not alive (or repeated) are skipped
+        void remove_range(std::span<const EntityID> range) {
+            std::vector<EntityID> removed;
+            removed.reserve(range.size());
+            detail::Signature pools;
+            for (const auto entity : range) {
+                if (not valid(entity)) continue;
+                pools |= signature(entity);
+                removed.push_back(entity);
+                release(entity);
+            }
+            pools.each([&](ui32 c) { indexed_pools[c].load(std::memory_order_relaxed)->remove(removed); });
+            for (auto pool : unindexed_pools) pool->remove(removed);
         }
     };
 
-    //* view
-    //! for now one component only, not C..., also needs to include the entity id, maybe divide dense and data again? check if entity valid as well
-    //! OK FINALLY, entt does it by using the dense array as data in the unspetialized array
+    //* view iterator
+    //      walks the dense array of the driving pool, skipping entities that are missing from any of the other pools
+    //      the driving pool is the smallest of the view, so the number of checks is bounded by its size
+    namespace detail
+    {
+        //: change filter
+        //      restricts a view to the entities whose component in a tracked pool was added or changed at or after a tick
+        struct ChangeFilter {
+            const ComponentPoolBase* pool;
+            bool added;
+            Tick since;
+
+            [[nodiscard]] constexpr bool operator()(const std::size_t pos) const noexcept {
+                return added ? pool->added_since(pos, since) : pool->changed_since(pos, since);
+            }
+        };
+
+        template <typename ... C>
+        struct ViewIterator {
+            //: iterator traits
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = decltype(std::tuple_cat(std::declval<std::tuple<EntityID>>(), std::declval<yielded_t<C...>>()));
+            using difference_type = std::ptrdiff_t;
+
+            //: component pools, both typed and as a base to check membership
+            std::tuple<ComponentPool<C>*...> pools;
+            std::array<const ComponentPoolBase*, sizeof...(C)> bases;
 
-    template <typename C>
+            //: driving pool and position in its dense array
+            const ComponentPoolBase* driver;
+            std::size_t pos;
+
+            //: change filters of the view
+            std::span<const ChangeFilter> filters;
+
+            //: signatures of the scene and the signature of the view, pools without a signature bit are checked one by one
+            const std::vector<Signature>* signatures;
+            Signature mask;
+
+            //: constructor, advances to the first valid entity
+            constexpr ViewIterator(std::tuple<ComponentPool<C>*...> p, const ComponentPoolBase* d, std::size_t i, std::span<const ChangeFilter> f = {}) :
+                pools(p), bases{std::get<ComponentPool<C>*>(p)...}, driver(d), pos(i), filters(f), signatures(nullptr),
+                mask(signature_of({std::get<ComponentPool<C>*>(p)...})) {
+                for (auto pool : bases) if (pool->signatures != nullptr) signatures = pool->signatures;
+                skip();
+            }
+
+            //: valid
+            //      checks if the entity at the current position is included in every pool of the view and passes its change filters
+            //      the signature of the entity index rejects most entities for all the pools with a signature bit at once, but it doesn't
+            //      know about versions, so the accepted ones are still checked against the other pools to skip components of stale ids
+            [[nodiscard]] constexpr bool valid() const noexcept {
+                if (signatures != nullptr) {
+                    const std::size_t i = driver->dense[pos].value;
+                    if (i >= signatures->size() or not (*signatures)[i].contains(mask)) return false;
+                }
+                const auto entity = driver->entity_at(pos);
+                return std::all_of(bases.begin(), bases.end(), [&](auto pool) { return pool == driver or pool->contains(entity); }) and
+                       std::all_of(filters.begin(), filters.end(), [&](const auto& f) { return f(f.pool == driver ? pos : f.pool->position(entity)); });
+            }
+
+            //: skip invalid entities until a valid one or the end is found
+            constexpr void skip() noexcept {
+                while (pos < driver->dense.size() and not valid()) ++pos;
+            }
+
+            //: get a component from a pool, the driving pool is accessed directly using the current position
+            template <typename T>
+            [[nodiscard]] constexpr ComponentRef<T> component(ComponentPool<T>* pool, const EntityID entity) const {
+                return pool == driver ? pool->data[pos] : pool->at(entity);
+            }
+
+            //: iterator operations
+            constexpr ViewIterator& operator++() noexcept { ++pos; skip(); return *this; }
+            constexpr ViewIterator operator++(int) noexcept { auto it = *this; ++(*this); return it; }
+            [[nodiscard]] constexpr value_type operator*() const {
+                const auto entity = driver->entity_at(pos);
+                if constexpr (not (concepts::TagComponent<C> or ...)) return value_type{entity, component(std::get<ComponentPool<C>*>(pools), entity)...};
+                else return std::tuple_cat(std::tuple<EntityID>{entity}, yield<C>([&]() -> ComponentRef<C> { return component(std::get<ComponentPool<C>*>(pools), entity); })...);
+            }
+            [[nodiscard]] constexpr bool operator==(const ViewIterator& other) const noexcept { return pos == other.pos; }
+        };
+
+        //: view job
+        //      job used by View::par_each to process a range of the view, the view and function outlive it since par_each waits
+        template <typename V, typename F>
+        jobs::JobFuture<void> view_job(const V& view, F& f, std::size_t first, std::size_t last) {
+            view.each(f, first, last);
+            co_return;
+        }
+    }
+
+    //* view
+    //      iterates over all the entities that have every one of the specified components, yielding (entity, components...) tuples
+    //          for (auto [e, pos, vel] : View<Position, Velocity>(scene)) { ... }
+    //      the smallest pool drives the iteration, the rest are filtered using their sparse arrays
+    template <typename ... C> requires (sizeof...(C) > 0)
     struct View {
         //: scene pointer
         Scene* scene;
 
-        //: if a scene view doesn't specify any types, it will iterate over all of them
-        static constexpr bool all = false;//sizeof...(C) == 0;
+        //: pools used by the view and the smallest one, which drives the iteration
+        std::tuple<ComponentPool<C>*...> pools;
+        const detail::ComponentPoolBase* driver;
+
+        //: change filters, see added and changed
+        std::vector<detail::ChangeFilter> filters;
 
         //: constructor
-        constexpr View(Scene& s) : scene(&s) {}
+        constexpr View(Scene& s) : scene(&s), pools{&s.cpool<C>()...} {
+            driver = std::min<const detail::ComponentPoolBase*>({std::get<ComponentPool<C>*>(pools)...},
+                                                                 [](auto a, auto b) { return a->size() < b->size(); });
+        }
+
+        //: added and changed
+        //      return a copy of the view that only visits the entities whose component T was added or changed at or after the given tick
+        //          for (auto [e, t] : View<Transform>(scene).changed<Transform>(since)) { ... }
+        template <typename T> requires (std::same_as<T, C> or ...)
+        [[nodiscard]] View added(const Tick since) const { return filter<T>(true, since); }
+        template <typename T> requires (std::same_as<T, C> or ...)
+        [[nodiscard]] View changed(const Tick since) const { return filter<T>(false, since); }
+
+        template <typename T>
+        [[nodiscard]] View filter(const bool added, const Tick since) const {
+            const auto pool = std::get<ComponentPool<T>*>(pools);
+            if (not pool->tracked) log::warn("filtering a view by changes in {}, which is not tracked", type_name<T>());
+            View view = *this;
+            view.filters.push_back(detail::ChangeFilter{pool, added, since});
+            return view;
+        }
 
         //: iterator
-        //      iterates over all entities that have the specified components
-        //      if no components are specified, it will iterate over all entities
-        [[nodiscard]] constexpr auto begin() const noexcept {
-            return scene->cpool<C>().begin();
+        [[nodiscard]] constexpr auto begin() const noexcept { return detail::ViewIterator<C...>(pools, driver, 0, filters); }
+        [[nodiscard]] constexpr auto end() const noexcept { return detail::ViewIterator<C...>(pools, driver, driver->size(), filters); }
+
+        //: each
+        //      calls f(entity, components...) for every entity in the view, without the tags
+        //      avoids constructing the tuples, so it is the preferred way for hot loops
+        template <typename F> requires concepts::EachFunction<F, C...>
+        constexpr void each(F&& f) const {
+            each(f, 0, driver->size());
         }
-        [[nodiscard]] constexpr auto end() const noexcept {
-            return scene->cpool<C>().end();
+
+        //: each in a range
+        //      same as each, but only for the entities in the range [first, last) of the driving pool dense array
+        template <typename F> requires concepts::EachFunction<F, C...>
+        constexpr void each(F&& f, std::size_t first, std::size_t last) const {
+            for (auto it = detail::ViewIterator<C...>(pools, driver, first, filters); it.pos < last; ++it) {
+                const auto entity = driver->entity_at(it.pos);
+                if constexpr (not (concepts::TagComponent<C> or ...)) f(entity, it.component(std::get<ComponentPool<C>*>(pools), entity)...);
+                else std::apply([&](auto&& ... c) { f(entity, std::forward<decltype(c)>(c)...); },
+                                std::tuple_cat(detail::yield<C>([&]() -> ComponentRef<C> { return it.component(std::get<ComponentPool<C>*>(pools), entity); })...));
+            }
+        }
+
+        //: parallel each
+        //      splits the dense array of the driving pool in ranges of `grain` entities and runs each of them as a job
+        //      it returns once all the jobs are done. f is called concurrently, so it may only modify the components it receives
+        //      if the job system is not running or there is only one range, it runs serially on the calling thread
+        //      it must not be called from inside a job, since the calling thread waits for the others without running jobs
+        template <typename F> requires concepts::EachFunction<F, C...>
+        void par_each(F&& f, std::size_t grain = 1024) const {
+            const auto n = driver->size();
+            if (grain == 0) grain = 1;
+            if (not jobs::JobSystem::running or n <= grain) { each(f); return; }
+
+            //: the futures are constructed in place on the heap, since destroying a copy of a job future destroys its coroutine
+            std::vector<std::unique_ptr<jobs::JobFuture<void>>> futures;
+            futures.reserve((n + grain - 1) / grain);
+            for (std::size_t first = 0; first < n; first += grain)
+                futures.emplace_back(new jobs::JobFuture<void>(detail::view_job(*this, f, first, std::min(first + grain, n))));
+
+            for (auto& j : futures) jobs::schedule(*j);
+            for (auto& j : futures) while (not j->done()) std::this_thread::yield();
         }
     };
 
-    namespace detail
-    {
-        template <std::size_t N>
-        struct ViewIterator {
-            std::array<const ComponentPoolBase*, N> pools;
+    //* interpolated view
+    //      iterates over every entity of a buffered pool yielding (entity, interpolated component) tuples, the components are copies
+    //          for (auto [e, t] : Interpolated<Transform>(scene, alpha)) draw(t);
+    template <typename C> requires concepts::Interpolable<C>
+    struct Interpolated {
+        //: pool and interpolation factor
+        ComponentPool<C>* pool;
+        float alpha;
 
+        //: constructor
+        constexpr Interpolated(Scene& s, const float a) : pool(&s.cpool<C>()), alpha(a) {
+            if (not pool->buffered) log::warn("interpolating {}, which is not buffered", type_name<C>());
+        }
+
+        //: iterator
+        struct Iterator {
+            const Interpolated* view;
+            std::size_t pos;
 
-            [[nodiscard]] bool valid() const noexcept {
-                
+            [[nodiscard]] constexpr std::tuple<EntityID, C> operator*() const {
+                const auto entity = view->pool->entity_at(pos);
+                return {entity, view->pool->interpolated(entity, view->alpha)};
             }
+            constexpr Iterator& operator++() noexcept { ++pos; return *this; }
+            [[nodiscard]] constexpr bool operator==(const Iterator& other) const noexcept { return pos == other.pos; }
         };
-    }
+        [[nodiscard]] constexpr Iterator begin() const noexcept { return {this, 0}; }
+        [[nodiscard]] constexpr Iterator end() const noexcept { return {this, pool->size()}; }
+
+        //: each
+        //      calls f(entity, component) for every entity, reading the buffers directly instead of going through the sparse array
+        template <typename F> requires std::invocable<F, EntityID, C>
+        constexpr void each(F&& f) const {
+            for (std::size_t i = 0; i < pool->size(); i++) {
+                if (pool->buffered) f(pool->entity_at(i), C(Interpolate<C>::lerp(C(pool->previous[i]), C(pool->data[i]), alpha)));
+                else f(pool->entity_at(i), C(pool->data[i]));
+            }
+        }
+    };
 }
\ No newline at end of file
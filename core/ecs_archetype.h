@@ -0,0 +1,348 @@
+//* ecs_archetype
+//      archetype based storage for the entity component system, an alternative to the sparse set pools of ecs::Scene
+//      entities with the same set of components (their signature) are grouped together in an archetype, which stores them
+//      in fixed size chunks using a structure of arrays layout, so iterating over multiple components is a linear walk
+//      adding or removing components from an entity moves it to another archetype, which makes structural changes more expensive,
+//      so this storage is better suited for large and stable worlds where multi component iteration dominates
+//      the design follows unity's dots chunks and @SanderMertens [flecs](https://github.com/SanderMertens/flecs) archetype graph
+#pragma once
+
+#include "ecs.h"
+#include <new>
+
+namespace fresa::ecs
+{
+    namespace detail
+    {
+        //* component info
+        //      type erased description of a component, used to move and destroy components stored as raw bytes inside chunks
+        struct ComponentInfo {
+            TypeHash hash;
+            std::size_t size;
+            std::size_t alignment;
+            void (*move)(void* dst, void* src);
+            void (*destroy)(void* p);
+        };
+
+        template <typename C>
+        [[nodiscard]] constexpr ComponentInfo component_info() {
+            static_assert(alignof(C) <= 64, "archetype components can't be aligned to more than a cache line");
+            return ComponentInfo{
+                .hash = type_hash<C>(),
+                .size = sizeof(C),
+                .alignment = alignof(C),
+                .move = [](void* dst, void* src) { new (dst) C(std::move(*static_cast<C*>(src))); },
+                .destroy = [](void* p) { static_cast<C*>(p)->~C(); }
+            };
+        }
+
+        //: true if no component type is repeated, each type has a single column in an archetype
+        template <typename ... C>
+        constexpr bool unique_types = true;
+        template <typename T, typename ... C>
+        constexpr bool unique_types<T, C...> = (not std::same_as<T, C> and ...) and unique_types<C...>;
+
+        //* chunk
+        //      a block of raw memory aligned to a cache line, the layout is decided by the archetype that owns it
+        struct ChunkDeleter {
+            void operator()(std::byte* p) const noexcept { ::operator delete[](p, std::align_val_t{64}); }
+        };
+        using Chunk = std::unique_ptr<std::byte[], ChunkDeleter>;
+
+        //* archetype
+        //      stores all the entities that share a signature, each chunk holds `capacity` rows with the following layout:
+        //          [ entity ids | component a | component b | ... ]
+        //      rows are kept packed, so removing an entity moves the last row into its place
+        struct Archetype {
+            //: signature, sorted component hashes and their type information in the same order
+            std::vector<ui64> signature;
+            std::vector<ComponentInfo> components;
+
+            //: chunk layout, offset of each component array and number of rows per chunk
+            std::vector<std::size_t> offsets;
+            std::size_t capacity = 0;
+            std::size_t chunk_bytes = 0;
+
+            //: chunks and number of rows in use
+            std::vector<Chunk> chunks;
+            std::size_t count = 0;
+
+            //: archetype graph, cached transitions when adding or removing a component
+            std::unordered_map<TypeHash, Archetype*> add_edges;
+            std::unordered_map<TypeHash, Archetype*> remove_edges;
+
+            //: constructor
+            //      calculates how many rows fit in a chunk of ecs_chunk_size() bytes, components are sorted by their hash
+            Archetype(std::vector<ComponentInfo> infos) : components(std::move(infos)) {
+                std::sort(components.begin(), components.end(), [](const auto& a, const auto& b) { return a.hash.value < b.hash.value; });
+                for (const auto& c : components) signature.push_back(c.hash.value);
+                offsets.resize(components.size());
+
+                std::size_t row_bytes = sizeof(EntityID);
+                for (const auto& c : components) row_bytes += c.size;
+
+                //: start with an estimate and reduce it until the aligned layout fits, at least one row is always stored
+                capacity = std::max<std::size_t>(engine_config.ecs_chunk_size() / row_bytes, 1);
+                while (layout(capacity) > engine_config.ecs_chunk_size() and capacity > 1) capacity--;
+                chunk_bytes = std::max<std::size_t>(layout(capacity), engine_config.ecs_chunk_size());
+            }
+
+            //: layout
+            //      fills the component offsets for a number of rows and returns the total size in bytes
+            std::size_t layout(std::size_t rows) {
+                std::size_t bytes = rows * sizeof(EntityID);
+                for (std::size_t i = 0; i < components.size(); i++) {
+                    bytes = (bytes + components[i].alignment - 1) / components[i].alignment * components[i].alignment;
+                    offsets[i] = bytes;
+                    bytes += rows * components[i].size;
+                }
+                return bytes;
+            }
+
+            //: column
+            //      returns the position of a component in the signature, or -1 if the archetype doesn't have it
+            [[nodiscard]] int column(const TypeHash hash) const noexcept {
+                for (std::size_t i = 0; i < signature.size(); i++)
+                    if (signature[i] == hash.value) return (int)i;
+                return -1;
+            }
+
+            //: row access
+            [[nodiscard]] EntityID& entity(const std::size_t row) noexcept {
+                return reinterpret_cast<EntityID*>(chunks[row / capacity].get())[row % capacity];
+            }
+            [[nodiscard]] void* at(const std::size_t col, const std::size_t row) noexcept {
+                return chunks[row / capacity].get() + offsets[col] + (row % capacity) * components[col].size;
+            }
+
+            //: push
+            //      reserves a new row at the end for an entity, allocating a new chunk if needed
+            //      the components of the row are left uninitialized and must be constructed by the caller
+            std::size_t push(const EntityID e) {
+                if (count == chunks.size() * capacity)
+                    chunks.emplace_back(static_cast<std::byte*>(::operator new[](chunk_bytes, std::align_val_t{64})));
+                new (&entity(count)) EntityID(e);
+                return count++;
+            }
+
+            //: erase
+            //      destroys the components of a row and moves the last row into its place
+            //      returns the entity that was moved, or invalid_id if the erased row was the last one
+            EntityID erase(const std::size_t row) {
+                const std::size_t last = count - 1;
+                EntityID moved = invalid_id;
+                for (std::size_t c = 0; c < components.size(); c++) {
+                    components[c].destroy(at(c, row));
+                    if (row != last) {
+                        components[c].move(at(c, row), at(c, last));
+                        components[c].destroy(at(c, last));
+                    }
+                }
+                if (row != last) {
+                    moved = entity(last);
+                    entity(row) = moved;
+                }
+                count--;
+
+                //: release the last chunk once it is empty
+                if (chunks.size() * capacity >= count + capacity)
+                    chunks.pop_back();
+                return moved;
+            }
+
+            //: destructor, calls the destructor of every stored component
+            ~Archetype() {
+                for (std::size_t row = 0; row < count; row++)
+                    for (std::size_t c = 0; c < components.size(); c++)
+                        components[c].destroy(at(c, row));
+            }
+        };
+    }
+
+    //---
+
+    //* archetype scene
+    //      scene with the same entity interface as ecs::Scene but backed by archetypes, choose it per scene depending on the workload
+    //          ecs::ArchetypeScene world;
+    //          auto e = world.add(Position{}, Velocity{});
+    //          world.each<Position, Velocity>([](EntityID e, Position& p, Velocity& v) { ... });
+    struct ArchetypeScene {
+        //* archetypes
+        //      every signature has one archetype, stored in a map using the sorted component hashes as the key
+        std::map<std::vector<ui64>, std::unique_ptr<detail::Archetype>> archetypes;
+
+        //: get or create the archetype with the given components
+        detail::Archetype& archetype(std::vector<detail::ComponentInfo> infos) {
+            std::vector<ui64> signature;
+            for (const auto& c : infos) signature.push_back(c.hash.value);
+            std::sort(signature.begin(), signature.end());
+
+            auto it = archetypes.find(signature);
+            if (it == archetypes.end())
+                it = archetypes.emplace(std::move(signature), std::make_unique<detail::Archetype>(std::move(infos))).first;
+            return *it->second;
+        }
+
+        //---
+
+        //* entities
+        //      each entity index has a record that points to the archetype and row where its components are stored
+        //      removed indices are reused, increasing their version
+        struct Record {
+            detail::Archetype* archetype = nullptr;
+            std::size_t row = 0;
+            Version version = 0;
+        };
+        std::vector<Record> records;
+        std::vector<Index> free_indices;
+
+        //: valid
+        //      checks if the entity is alive and its version matches
+        [[nodiscard]] bool valid(const EntityID entity) const noexcept {
+            const std::size_t i = index(entity).value;
+            return i < records.size() and records[i].archetype != nullptr and records[i].version == version(entity);
+        }
+
+        //: add entity
+        template <typename ... C>
+        const EntityID add(C&& ... components) {
+            static_assert(detail::unique_types<std::decay_t<C>...>, "an entity can't be added with the same component type twice");
+            auto& a = archetype({detail::component_info<std::decay_t<C>>()...});
+
+            //: reuse a free index or create a new one
+            EntityID entity;
+            if (free_indices.empty()) {
+                if (records.size() == max_entities) {
+                    log::error("the scene is full, increase ecs_index_bits() to hold more than {} entities", max_entities);
+                    return invalid_id;
+                }
+                entity = id(Index(records.size()), Version(0));
+                records.emplace_back();
+            } else {
+                entity = id(free_indices.back(), records[free_indices.back().value].version);
+                free_indices.pop_back();
+            }
+
+            const auto row = a.push(entity);
+            (new (a.at(a.column(type_hash<std::decay_t<C>>()), row)) std::decay_t<C>(std::forward<C>(components)), ...);
+            records[index(entity).value] = Record{&a, row, version(entity)};
+            return entity;
+        }
+
+        //: get entity component
+        //      returns a pointer to the component, or nullptr if the entity doesn't have it
+        template <typename C>
+        [[nodiscard]] C* get(const EntityID entity) noexcept {
+            if (not valid(entity)) return nullptr;
+            const auto& r = records[index(entity).value];
+            const auto col = r.archetype->column(type_hash<C>());
+            return col < 0 ? nullptr : static_cast<C*>(r.archetype->at(col, r.row));
+        }
+
+        //: emplace component
+        //      adds a component to an existing entity moving it to a new archetype, if it already has it the value is replaced
+        template <typename C>
+        void emplace(const EntityID entity, C&& value) {
+            using T = std::decay_t<C>;
+            if (not valid(entity)) { log::error("entity {} is not valid", entity.value); return; }
+            if (auto c = get<T>(entity)) { *c = std::forward<C>(value); return; }
+
+            auto& r = records[index(entity).value];
+            constexpr TypeHash hash = type_hash<T>();
+
+            //: follow the archetype graph, creating the edge if it is the first time
+            auto& to = r.archetype->add_edges[hash];
+            if (to == nullptr) {
+                auto infos = r.archetype->components;
+                infos.push_back(detail::component_info<T>());
+                to = &archetype(std::move(infos));
+                to->remove_edges[hash] = r.archetype;
+            }
+
+            const auto row = move(entity, *to);
+            new (to->at(to->column(hash), row)) T(std::forward<C>(value));
+        }
+
+        //: erase component
+        //      removes a component from an entity moving it to a new archetype, does nothing if the entity doesn't have it
+        template <typename C>
+        void erase(const EntityID entity) {
+            if (get<C>(entity) == nullptr) return;
+
+            auto& r = records[index(entity).value];
+            constexpr TypeHash hash = type_hash<C>();
+
+            auto& to = r.archetype->remove_edges[hash];
+            if (to == nullptr) {
+                auto infos = r.archetype->components;
+                std::erase_if(infos, [&](const auto& c) { return c.hash == hash; });
+                to = &archetype(std::move(infos));
+                to->add_edges[hash] = r.archetype;
+            }
+
+            move(entity, *to);
+        }
+
+        //: remove entity
+        void remove(const EntityID entity) {
+            if (not valid(entity)) return;
+            auto& r = records[index(entity).value];
+            release(*r.archetype, r.row);
+            r.archetype = nullptr;
+            r.version = r.version + Version(1);
+            free_indices.push_back(index(entity));
+        }
+
+        //: each
+        //      calls f(entity, components...) for each entity that has all the components
+        //      whole archetypes are skipped if they don't match, and matching ones are walked chunk by chunk
+        template <typename ... C, typename F> requires std::invocable<F, EntityID, C&...>
+        void each(F&& f) {
+            for (auto& [signature, a] : archetypes) {
+                if (a->count == 0) continue;
+
+                //: column of each component, skip the archetype if one is missing
+                const std::array<int, sizeof...(C)> cols = {a->column(type_hash<C>())...};
+                if (std::any_of(cols.begin(), cols.end(), [](int c) { return c < 0; })) continue;
+
+                for (std::size_t chunk = 0; chunk < a->chunks.size(); chunk++) {
+                    std::byte* base = a->chunks[chunk].get();
+                    const auto rows = std::min(a->capacity, a->count - chunk * a->capacity);
+                    const auto entities = reinterpret_cast<EntityID*>(base);
+                    [&]<std::size_t ... I>(std::index_sequence<I...>) {
+                        const auto arrays = std::make_tuple(reinterpret_cast<C*>(base + a->offsets[cols[I]])...);
+                        for (std::size_t row = 0; row < rows; row++)
+                            f(entities[row], std::get<I>(arrays)[row]...);
+                    }(std::index_sequence_for<C...>{});
+                }
+            }
+        }
+
+        //: move
+        //      moves an entity and its shared components to another archetype, returning the new row
+        //      components not present in the source archetype are left uninitialized
+        std::size_t move(const EntityID entity, detail::Archetype& to) {
+            auto& r = records[index(entity).value];
+            auto& from = *r.archetype;
+
+            const auto row = to.push(entity);
+            for (std::size_t c = 0; c < from.components.size(); c++) {
+                const auto col = to.column(from.components[c].hash);
+                if (col >= 0) from.components[c].move(to.at(col, row), from.at(c, r.row));
+            }
+
+            release(from, r.row);
+            r.archetype = &to;
+            r.row = row;
+            return row;
+        }
+
+        //: release
+        //      erases a row from an archetype, updating the record of the entity that takes its place
+        void release(detail::Archetype& a, const std::size_t row) {
+            const auto moved = a.erase(row);
+            if (moved != invalid_id)
+                records[index(moved).value].row = row;
+        }
+    };
+}
@@ -0,0 +1,240 @@
+//* ecs_commands
+//      deferred structural changes for the sparse set scene
+//      pools and the entity free list are not thread safe, so jobs record the changes they want to make in a command buffer
+//      and the buffers are flushed into the scene at a sync point, for example after View::par_each returns
+//      commands are stored in a compact binary form, a fixed header followed by the component value, in blocks that are reused
+//      between flushes. flushing sorts them by component pool so each pool is looked up once, and applies entity removals last
+#pragma once
+
+#include "ecs.h"
+#include <new>
+#include <utility>
+
+namespace fresa::ecs
+{
+    namespace detail
+    {
+        //* command
+        //      header of a recorded command, the component value (if any) is stored right after it, aligned to its type
+        //      pool returns the component pool of the command from the scene, creating it if needed
+        //      apply performs the command on that pool and destroys the stored value, if the pool is null it only destroys the value
+        struct Command {
+            enum Op : ui8 { Emplace, Erase, Remove };
+
+            Op op;
+            TypeHash type;
+            EntityID entity;
+            ComponentPoolBase* (*pool)(Scene& scene);
+            void (*apply)(Command& command, ComponentPoolBase* pool);
+
+            //: payload, the stored value of a command recorded for component C
+            template <typename C>
+            [[nodiscard]] C* payload() noexcept {
+                const auto p = reinterpret_cast<std::uintptr_t>(this) + sizeof(Command);
+                return reinterpret_cast<C*>((p + alignof(C) - 1) & ~(std::uintptr_t)(alignof(C) - 1));
+            }
+
+            //: size in bytes needed to store a command for component C, including the padding before its value
+            template <typename C>
+            [[nodiscard]] static constexpr std::size_t size() noexcept {
+                return sizeof(Command) + (alignof(C) > alignof(Command) ? alignof(C) - alignof(Command) : 0) + sizeof(C);
+            }
+        };
+
+        //* command block
+        //      raw memory for commands, blocks never reallocate so stored values don't move until they are applied
+        struct CommandBlock {
+            std::unique_ptr<std::byte[]> memory;
+            std::size_t capacity = 0;
+            std::size_t used = 0;
+        };
+    }
+
+    //* command buffer
+    //      records add, emplace, erase and remove operations to apply later to a scene, without locking
+    //      a buffer must only be used by one thread at a time, use CommandBuffers to get one per worker thread
+    //          auto& cmd = commands.local();
+    //          auto e = cmd.add(scene, Position{}, Velocity{});
+    //          cmd.erase<Velocity>(other);
+    struct CommandBuffer {
+        //: block size in bytes, larger commands get a block of their own
+        static constexpr std::size_t block_size = 4096;
+
+        //: storage blocks, the block currently being written and the recorded commands in order
+        std::vector<detail::CommandBlock> blocks;
+        std::size_t current = 0;
+        std::vector<detail::Command*> commands;
+
+        //: default constructor, no copy
+        CommandBuffer() = default;
+        CommandBuffer(const CommandBuffer&) = delete;
+        CommandBuffer& operator=(const CommandBuffer&) = delete;
+        CommandBuffer(CommandBuffer&&) = default;
+
+        //: move assignment, the commands this buffer still holds are discarded first so their values are destroyed
+        CommandBuffer& operator=(CommandBuffer&& other) noexcept {
+            if (this == &other) return *this;
+            clear();
+            blocks = std::move(other.blocks);
+            commands = std::move(other.commands);
+            current = std::exchange(other.current, 0);
+            other.blocks.clear();
+            other.commands.clear();
+            return *this;
+        }
+
+        //: destructor, commands that were never flushed still destroy their values
+        ~CommandBuffer() { clear(); }
+
+        //: add entity
+        //      reserves an entity id from the scene, which is safe from any thread, and records its components
+        //      the returned id can be used right away in other commands, the components are added on flush
+        template <typename ... C>
+        EntityID add(Scene& scene, C&& ... components) {
+            const auto entity = scene.reserve();
+            if (entity == invalid_id) return entity;
+            (emplace(entity, std::forward<C>(components)), ...);
+            return entity;
+        }
+
+        //: emplace component
+        //      adds the component to the entity on flush, or replaces its value if the entity already has one
+        template <typename C>
+        void emplace(const EntityID entity, C&& component) {
+            using T = std::remove_cvref_t<C>;
+            detail::Command& command = push(detail::Command::size<T>(), alignof(T) > alignof(detail::Command) ? alignof(T) : alignof(detail::Command));
+            command = detail::Command{
+                .op = detail::Command::Emplace,
+                .type = type_hash<T>(),
+                .entity = entity,
+                .pool = [](Scene& scene) -> detail::ComponentPoolBase* { return &scene.cpool<T>(); },
+                .apply = [](detail::Command& c, detail::ComponentPoolBase* base) {
+                    const auto value = c.payload<T>();
+                    if (base != nullptr) {
+                        auto& pool = static_cast<ComponentPool<T>&>(*base);
+                        if (pool.contains(c.entity)) *pool.patch(c.entity) = std::move(*value);
+                        else pool.add(c.entity, std::move(*value));
+                    }
+                    value->~T();
+                }
+            };
+            new (command.payload<T>()) T(std::forward<C>(component));
+        }
+
+        //: erase component
+        //      removes the component from the entity on flush, if it has it
+        template <typename C>
+        void erase(const EntityID entity) {
+            detail::Command& command = push(sizeof(detail::Command), alignof(detail::Command));
+            command = detail::Command{
+                .op = detail::Command::Erase,
+                .type = type_hash<C>(),
+                .entity = entity,
+                .pool = [](Scene& scene) -> detail::ComponentPoolBase* { return &scene.cpool<C>(); },
+                .apply = [](detail::Command& c, detail::ComponentPoolBase* base) { if (base != nullptr) base->remove(c.entity); }
+            };
+        }
+
+        //: remove entity
+        //      removes the entity and all its components on flush, after every other command
+        void remove(const EntityID entity) {
+            detail::Command& command = push(sizeof(detail::Command), alignof(detail::Command));
+            command = detail::Command{ .op = detail::Command::Remove, .type = TypeHash{}, .entity = entity, .pool = nullptr, .apply = nullptr };
+        }
+
+        //: number of recorded commands
+        [[nodiscard]] std::size_t size() const noexcept { return commands.size(); }
+        [[nodiscard]] bool empty() const noexcept { return commands.empty(); }
+
+        //: clear
+        //      discards the recorded commands, destroying their values, and keeps the blocks to reuse them
+        void clear() {
+            for (auto c : commands) if (c->apply != nullptr) c->apply(*c, nullptr);
+            commands.clear();
+            for (auto& b : blocks) b.used = 0;
+            current = 0;
+        }
+
+        //: push
+        //      reserves space for a command in the current block, moving to the next one or allocating a new one if it doesn't fit
+        detail::Command& push(const std::size_t bytes, const std::size_t alignment) {
+            for (; current < blocks.size(); current++) {
+                auto& b = blocks[current];
+                const auto start = reinterpret_cast<std::uintptr_t>(b.memory.get());
+                const auto offset = ((start + b.used + alignment - 1) & ~(std::uintptr_t)(alignment - 1)) - start;
+                if (offset + bytes <= b.capacity) {
+                    b.used = offset + bytes;
+                    return *commands.emplace_back(new (b.memory.get() + offset) detail::Command);
+                }
+            }
+            const auto capacity = std::max(block_size, bytes + alignment);
+            blocks.push_back(detail::CommandBlock{std::make_unique<std::byte[]>(capacity), capacity, 0});
+            return push(bytes, alignment);
+        }
+    };
+
+    namespace detail
+    {
+        //: flush
+        //      applies the commands of several buffers to the scene and clears them
+        //      component commands are stable sorted by pool, so commands for the same pool keep the order in which they were recorded
+        //      (buffer by buffer), and each pool is looked up once. entity removals are applied last as a single remove_range
+        //      commands for entities that are not alive anymore (removed from the scene before the flush) only destroy their values
+        inline void flush(Scene& scene, std::span<CommandBuffer> buffers) {
+            scene.commit_reserved();
+
+            //: the sort key is copied next to the command pointer, so sorting doesn't read the headers scattered across the blocks
+            std::vector<std::pair<ui64, Command*>> commands;
+            std::vector<EntityID> removed;
+            for (auto& b : buffers) {
+                for (auto c : b.commands) {
+                    if (c->op == Command::Remove) removed.push_back(c->entity);
+                    else commands.emplace_back(c->type.value, c);
+                }
+            }
+            std::stable_sort(commands.begin(), commands.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+            ComponentPoolBase* pool = nullptr;
+            for (std::size_t i = 0; i < commands.size(); i++) {
+                auto c = commands[i].second;
+                if (i == 0 or commands[i].first != commands[i - 1].first)
+                    pool = c->pool(scene);
+                c->apply(*c, scene.valid(c->entity) ? pool : nullptr);
+                c->apply = nullptr;
+            }
+            if (not removed.empty()) scene.remove_range(removed);
+
+            for (auto& b : buffers) b.clear();
+        }
+    }
+
+    //* command buffers
+    //      one command buffer per worker thread of the job system plus one for any other thread, so jobs can record commands without locking
+    //      flush must be called from a sync point where no job is recording commands
+    struct CommandBuffers {
+        //: buffers, the last one is used by threads outside the job system
+        std::vector<CommandBuffer> buffers;
+
+        //: constructor, the job system starts one worker per hardware thread
+        CommandBuffers() : buffers(std::max(1u, std::thread::hardware_concurrency()) + 1) {}
+
+        //: local buffer of the calling thread
+        [[nodiscard]] CommandBuffer& local() noexcept {
+            const bool worker = jobs::JobSystem::current_job.has_value() and jobs::JobSystem::thread_index < buffers.size() - 1;
+            return buffers[worker ? jobs::JobSystem::thread_index : buffers.size() - 1];
+        }
+
+        //: number of recorded commands in all buffers
+        [[nodiscard]] std::size_t size() const noexcept {
+            std::size_t n = 0;
+            for (const auto& b : buffers) n += b.size();
+            return n;
+        }
+
+        //: apply all the recorded commands to the scene
+        void flush(Scene& scene) { detail::flush(scene, buffers); }
+    };
+
+    //: apply the commands of a single buffer to the scene
+    inline void flush(Scene& scene, CommandBuffer& buffer) { detail::flush(scene, std::span<CommandBuffer>(&buffer, 1)); }
+}
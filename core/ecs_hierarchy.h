@@ -0,0 +1,233 @@
+//* ecs_hierarchy
+//      parent and child relationships between entities with transform propagation
+//      every entity in the hierarchy has a Node component with its parent, the links to its children and its depth,
+//      plus a LocalTransform relative to its parent and a WorldTransform that propagate() computes from them
+//          ecs::SceneGraph graph(scene);
+//          graph.attach(arm, body);
+//          scene.patch<ecs::LocalTransform>(arm)->matrix = rotation;
+//          graph.propagate(since);
+//      before propagating, the node pool is sorted by depth and the transform pools are sorted as it, so position i of the three
+//      pools is the same entity and every parent comes before its children. propagation is then a linear pass without sparse lookups,
+//      where each world transform reads the already computed one of its parent from a cached position
+//      nodes must be attached, detached and destroyed through the graph, removing them with Scene::remove leaves dangling links
+#pragma once
+
+#include "ecs.h"
+#include "fresa_math.h"
+
+namespace fresa::ecs
+{
+    //: hierarchy node, the links form a doubly linked list of siblings for each parent
+    //      parent_position is the position of the parent in the node pool, updated every time the graph is sorted
+    struct Node {
+        EntityID parent = invalid_id;
+        EntityID first_child = invalid_id;
+        EntityID next_sibling = invalid_id;
+        EntityID prev_sibling = invalid_id;
+        ui32 depth = 0;
+        std::size_t parent_position = max_entities;
+    };
+
+    //: transforms, local is relative to the parent and world is the result of propagating it through the hierarchy
+    struct LocalTransform { Mat4<float> matrix = identity<float, 4>(); };
+    struct WorldTransform { Mat4<float> matrix = identity<float, 4>(); };
+
+    struct SceneGraph;
+    namespace detail
+    {
+        //: job that propagates the transforms of a range of nodes of the same depth
+        jobs::JobFuture<void> propagate_job(SceneGraph& graph, std::size_t first, std::size_t last, Tick since);
+    }
+
+    //* scene graph
+    //      operates on the node and transform pools of a scene, which it creates, enabling change tracking for local transforms
+    //      so that propagate only recomputes the subtrees whose local transforms changed
+    struct SceneGraph {
+        //: scene and pools
+        Scene* scene;
+        ComponentPool<Node>* nodes;
+        ComponentPool<LocalTransform>* locals;
+        ComponentPool<WorldTransform>* worlds;
+
+        //: order state, levels holds the first position of each depth in the sorted pools followed by the end of the last one
+        bool ordered = true;
+        std::vector<std::size_t> levels;
+
+        //: nodes whose world transform was recomputed in the last propagation, indexed by position
+        std::vector<ui8> dirty;
+
+        //: constructor
+        SceneGraph(Scene& s) : scene(&s), nodes(&s.cpool<Node>()), locals(&s.cpool<LocalTransform>()), worlds(&s.cpool<WorldTransform>()) {
+            s.track<LocalTransform>();
+        }
+
+        //* structure
+
+        //: add
+        //      makes an entity a root of the hierarchy if it isn't in it yet, adding its node and transforms
+        void add(const EntityID entity) {
+            if (nodes->contains(entity)) return;
+            nodes->add(entity, Node{});
+            if (not locals->contains(entity)) locals->add(entity, LocalTransform{});
+            if (not worlds->contains(entity)) worlds->add(entity, WorldTransform{});
+            ordered = false;
+        }
+
+        //: attach
+        //      sets the parent of an entity, moving it with its subtree if it already had one. both are added to the hierarchy if needed
+        //      an entity can't be attached to itself or to one of its descendants
+        void attach(const EntityID child, const EntityID parent) {
+            for (auto e = parent; e != invalid_id; e = nodes->contains(e) ? nodes->at(e).parent : invalid_id) {
+                if (e == child) { log::error("can't attach entity {} to one of its descendants", child.value); return; }
+            }
+            add(parent);
+            add(child);
+            unlink(child);
+
+            auto& node = nodes->at(child);
+            auto& p = nodes->at(parent);
+            node.parent = parent;
+            node.next_sibling = p.first_child;
+            if (p.first_child != invalid_id) nodes->at(p.first_child).prev_sibling = child;
+            p.first_child = child;
+            set_depth(child, p.depth + 1);
+        }
+
+        //: detach
+        //      makes an entity a root, keeping its subtree
+        void detach(const EntityID entity) {
+            if (not nodes->contains(entity)) return;
+            unlink(entity);
+            set_depth(entity, 0);
+        }
+
+        //: destroy
+        //      removes an entity and all its descendants from the scene
+        void destroy(const EntityID entity) {
+            if (not nodes->contains(entity)) { scene->remove(entity); return; }
+            unlink(entity);
+            std::vector<EntityID> subtree;
+            each_descendant(entity, [&](EntityID e) { subtree.push_back(e); });
+            subtree.push_back(entity);
+            scene->remove_range(subtree);
+            ordered = false;
+        }
+
+        //: parent of an entity, invalid_id for roots and entities outside the hierarchy
+        [[nodiscard]] EntityID parent(const EntityID entity) const {
+            return nodes->contains(entity) ? nodes->at(entity).parent : invalid_id;
+        }
+
+        //: calls f(child) for every direct child of an entity
+        template <typename F> requires std::invocable<F, EntityID>
+        void each_child(const EntityID entity, F&& f) const {
+            if (not nodes->contains(entity)) return;
+            for (auto c = nodes->at(entity).first_child; c != invalid_id; c = nodes->at(c).next_sibling) f(c);
+        }
+
+        //: calls f(descendant) for every descendant of an entity, parents before their children
+        template <typename F> requires std::invocable<F, EntityID>
+        void each_descendant(const EntityID entity, F&& f) const {
+            std::vector<EntityID> stack;
+            each_child(entity, [&](EntityID c) { stack.push_back(c); });
+            while (not stack.empty()) {
+                const auto e = stack.back();
+                stack.pop_back();
+                f(e);
+                each_child(e, [&](EntityID c) { stack.push_back(c); });
+            }
+        }
+
+        //: unlink
+        //      removes an entity from the children list of its parent
+        void unlink(const EntityID entity) {
+            auto& node = nodes->at(entity);
+            if (node.parent == invalid_id) return;
+            if (node.prev_sibling != invalid_id) nodes->at(node.prev_sibling).next_sibling = node.next_sibling;
+            else nodes->at(node.parent).first_child = node.next_sibling;
+            if (node.next_sibling != invalid_id) nodes->at(node.next_sibling).prev_sibling = node.prev_sibling;
+            node.parent = node.next_sibling = node.prev_sibling = invalid_id;
+            ordered = false;
+        }
+
+        //: set the depth of an entity and update the ones of its descendants
+        void set_depth(const EntityID entity, const ui32 depth) {
+            nodes->at(entity).depth = depth;
+            each_descendant(entity, [&](EntityID e) { nodes->at(e).depth = nodes->at(nodes->at(e).parent).depth + 1; });
+            ordered = false;
+        }
+
+        //* order
+
+        //: order
+        //      sorts the node pool by depth with a stable radix sort, then sorts the transform pools as it,
+        //      and caches the position of each parent and the range of each depth level
+        void order() {
+            if (ordered) return;
+            nodes->sort_by([](const Node& n) { return n.depth; });
+            locals->sort_as(*nodes);
+            worlds->sort_as(*nodes);
+
+            levels.clear();
+            for (std::size_t i = 0; i < nodes->size(); i++) {
+                auto& node = nodes->data[i];
+                node.parent_position = node.parent != invalid_id ? nodes->position(node.parent) : max_entities;
+                while (levels.size() <= node.depth) levels.push_back(i);
+            }
+            levels.push_back(nodes->size());
+            dirty.assign(nodes->size(), 1);
+            ordered = true;
+        }
+
+        //* propagation
+        //      recomputes the world transform of the nodes whose local transform changed at or after `since`, and of all their descendants
+        //      after the graph is reordered (because of a structural change) every node is recomputed
+        //          const auto since = last_run; last_run = scene.tick;
+        //          graph.propagate(since);
+
+        //: propagate the nodes in the range [first, last) of the sorted pools, the parents of all of them must be already propagated
+        void propagate_range(const std::size_t first, const std::size_t last, const Tick since) {
+            for (std::size_t i = first; i < last; i++) {
+                const auto& node = nodes->data[i];
+                const bool root = node.parent_position == max_entities;
+                dirty[i] = locals->changed_since(i, since) or (not root and dirty[node.parent_position]);
+                if (not dirty[i]) continue;
+                worlds->data[i].matrix = root ? locals->data[i].matrix : worlds->data[node.parent_position].matrix * locals->data[i].matrix;
+            }
+        }
+
+        //: propagate the whole hierarchy in a single linear pass
+        void propagate(Tick since = 0) {
+            if (not ordered) { order(); since = 0; }
+            propagate_range(0, nodes->size(), since);
+        }
+
+        //: parallel propagation
+        //      the depth levels are propagated one after the other, and each level is split in ranges of `grain` nodes that run as jobs
+        //      it must not be called from inside a job, and it runs serially if the job system is not running
+        void par_propagate(Tick since = 0, std::size_t grain = 1024) {
+            if (not ordered) { order(); since = 0; }
+            if (not jobs::JobSystem::running) { propagate_range(0, nodes->size(), since); return; }
+            if (grain == 0) grain = 1;
+
+            std::vector<std::unique_ptr<jobs::JobFuture<void>>> futures;
+            for (std::size_t l = 0; l + 1 < levels.size(); l++) {
+                const auto begin = levels[l], end = levels[l + 1];
+                if (end - begin <= grain) { propagate_range(begin, end, since); continue; }
+                futures.clear();
+                for (std::size_t first = begin; first < end; first += grain)
+                    futures.emplace_back(new jobs::JobFuture<void>(detail::propagate_job(*this, first, std::min(first + grain, end), since)));
+                for (auto& j : futures) jobs::schedule(*j);
+                for (auto& j : futures) while (not j->done()) std::this_thread::yield();
+            }
+        }
+    };
+
+    namespace detail
+    {
+        inline jobs::JobFuture<void> propagate_job(SceneGraph& graph, std::size_t first, std::size_t last, Tick since) {
+            graph.propagate_range(first, last, since);
+            co_return;
+        }
+    }
+}
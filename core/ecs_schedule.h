@@ -0,0 +1,212 @@
+//* ecs_schedule
+//      runs ecs systems concurrently on the job system according to the components they access
+//      every system declares the components it reads and writes, two systems conflict if one of them writes a component that
+//      the other reads or writes, and conflicting systems run in priority order (then in the order they were added)
+//          ecs::Schedule schedule;
+//          schedule.add<ecs::Read<Velocity>, ecs::Write<Position>>("movement", [&]{ ... });
+//          schedule.add<ecs::Read<Position>>("render", [&]{ ... }, system::SYSTEM_PRIORITY_LAST);
+//          schedule.run();
+//      the dependency graph is built when the schedule changes and cached, then each run starts the systems without dependencies
+//      as jobs, and every finished system starts the ones that were only waiting for it, so the frame takes the critical path
+//      instead of the sum of all the systems. systems that run concurrently must not add or remove entities or components,
+//      they can record them in a command buffer (see ecs_commands.h) or declare ecs::Exclusive to run alone
+//      the engine runs ecs::schedule on every simulation step, systems are registered into it with their access using add_system
+#pragma once
+
+#include "ecs.h"
+#include "system.h"
+#include <functional>
+
+namespace fresa::ecs
+{
+    //: access declarations, a system that writes a component doesn't need to also declare that it reads it
+    template <typename ... C> struct Read {};
+    template <typename ... C> struct Write {};
+    struct Exclusive {};
+
+    struct Schedule;
+    namespace detail
+    {
+        //* access
+        //      sorted component ids that a system reads and writes, exclusive systems conflict with every other
+        struct Access {
+            std::vector<ui32> reads;
+            std::vector<ui32> writes;
+            bool exclusive = false;
+
+            //: true if the two systems can't run at the same time
+            [[nodiscard]] bool conflicts(const Access& other) const {
+                const auto intersect = [](const std::vector<ui32>& a, const std::vector<ui32>& b) {
+                    for (auto i = a.begin(), j = b.begin(); i != a.end() and j != b.end();) {
+                        if (*i == *j) return true;
+                        *i < *j ? ++i : ++j;
+                    }
+                    return false;
+                };
+                return exclusive or other.exclusive or intersect(writes, other.writes) or
+                       intersect(writes, other.reads) or intersect(reads, other.writes);
+            }
+        };
+
+        //: adds the component ids of an access declaration
+        template <typename A> struct access_of;
+        template <typename ... C> struct access_of<Read<C...>> {
+            static void add(Access& a) { (a.reads.push_back(component_id<C>()), ...); }
+        };
+        template <typename ... C> struct access_of<Write<C...>> {
+            static void add(Access& a) { (a.writes.push_back(component_id<C>()), ...); }
+        };
+        template <> struct access_of<Exclusive> {
+            static void add(Access& a) { a.exclusive = true; }
+        };
+
+        template <typename ... A>
+        [[nodiscard]] Access make_access() {
+            Access a;
+            (access_of<A>::add(a), ...);
+            for (auto v : {&a.reads, &a.writes}) {
+                std::sort(v->begin(), v->end());
+                v->erase(std::unique(v->begin(), v->end()), v->end());
+            }
+            std::erase_if(a.reads, [&](ui32 c) { return std::binary_search(a.writes.begin(), a.writes.end(), c); });
+            return a;
+        }
+
+        //: job that runs a system of a schedule and starts its successors
+        jobs::JobFuture<void> system_job(Schedule& schedule, std::size_t i);
+    }
+
+    namespace concepts
+    {
+        template <typename A>
+        concept AccessDeclaration = requires(detail::Access& a) { detail::access_of<A>::add(a); };
+    }
+
+    //* schedule
+    struct Schedule {
+        //: system, successors are the systems that wait for this one and dependencies the number of systems it waits for
+        struct System {
+            str name;
+            ui8 priority;
+            detail::Access access;
+            std::function<void()> f;
+            std::vector<std::size_t> successors = {};
+            ui32 dependencies = 0;
+        };
+
+        //: systems sorted by priority once the graph is built
+        std::vector<System> systems;
+        bool built = true;
+
+        //: state of a run, the pending dependencies of each system and its job
+        std::unique_ptr<std::atomic<ui32>[]> pending;
+        std::vector<std::unique_ptr<jobs::JobFuture<void>>> futures;
+
+        //: add a system with its access declarations
+        template <concepts::AccessDeclaration ... A, typename F> requires std::invocable<F>
+        void add(str_view name, F&& f, ui8 priority = system::SYSTEM_PRIORITY_DEFAULT) {
+            systems.push_back(System{str(name), priority, detail::make_access<A...>(), std::forward<F>(f)});
+            built = false;
+        }
+
+        //: remove a system by name
+        void remove(str_view name) {
+            if (std::erase_if(systems, [&](const System& s) { return s.name == name; }) == 0)
+                log::warn("there is no system '{}' in the schedule", name);
+            built = false;
+        }
+
+        //: build
+        //      sorts the systems by priority and adds an edge from every system to each later one that conflicts with it,
+        //      skipping the edges already implied by another path, so that each system only waits for its direct predecessors
+        void build() {
+            if (built) return;
+            std::stable_sort(systems.begin(), systems.end(), [](const System& a, const System& b) { return a.priority < b.priority; });
+
+            //: reachable[j] marks the systems that j already waits for, directly or through other systems
+            const auto n = systems.size();
+            std::vector<std::vector<bool>> reachable(n, std::vector<bool>(n, false));
+            for (auto& s : systems) { s.successors.clear(); s.dependencies = 0; }
+            for (std::size_t j = 0; j < n; j++) {
+                for (std::size_t i = j; i-- > 0;) {
+                    if (reachable[j][i] or not systems[j].access.conflicts(systems[i].access)) continue;
+                    systems[i].successors.push_back(j);
+                    systems[j].dependencies++;
+                    reachable[j][i] = true;
+                    for (std::size_t k = 0; k < i; k++) if (reachable[i][k]) reachable[j][k] = true;
+                }
+            }
+            pending = std::make_unique<std::atomic<ui32>[]>(n);
+            built = true;
+        }
+
+        //: run
+        //      runs every system once, concurrently as jobs if the job system is running or one after the other otherwise
+        //      it must not be called from inside a job, since it waits for the systems to finish
+        void run() {
+            build();
+            if (not jobs::JobSystem::running) {
+                for (auto& s : systems) s.f();
+                return;
+            }
+
+            //: the futures are constructed in place on the heap, since destroying a copy of a job future destroys its coroutine
+            futures.clear();
+            for (std::size_t i = 0; i < systems.size(); i++) {
+                pending[i] = systems[i].dependencies;
+                futures.emplace_back(new jobs::JobFuture<void>(detail::system_job(*this, i)));
+            }
+            for (std::size_t i = 0; i < systems.size(); i++) if (systems[i].dependencies == 0) jobs::schedule(*futures[i]);
+            for (auto& j : futures) while (not j->done()) std::this_thread::yield();
+        }
+
+        //: length of the longest chain of systems that have to run one after the other
+        [[nodiscard]] std::size_t critical_path() {
+            build();
+            std::vector<std::size_t> length(systems.size(), 1);
+            std::size_t longest = 0;
+            for (std::size_t i = 0; i < systems.size(); i++) {
+                for (auto s : systems[i].successors) length[s] = std::max(length[s], length[i] + 1);
+                longest = std::max(longest, length[i]);
+            }
+            return longest;
+        }
+    };
+
+    namespace detail
+    {
+        inline jobs::JobFuture<void> system_job(Schedule& schedule, std::size_t i) {
+            schedule.systems[i].f();
+            for (auto s : schedule.systems[i].successors)
+                if (schedule.pending[s].fetch_sub(1) == 1) jobs::schedule(*schedule.futures[s]);
+            co_return;
+        }
+    }
+    //* engine schedule
+    //      run by the engine on every simulation step (see update() below), so systems that declare their access run concurrently
+    //          ecs::add_system<ecs::Read<Velocity>, ecs::Write<Position>>(Movement{});
+    //      systems registered with system::add don't declare their access, so they are moved into it as exclusive systems
+    inline Schedule schedule;
+
+    //: register and initialize a system with its access declarations, its update is added to the engine schedule
+    template <concepts::AccessDeclaration ... A>
+    void add_system(system::concepts::System auto s, ui8 priority = system::SYSTEM_PRIORITY_DEFAULT) {
+        constexpr auto name = type_name<decltype(s)>();
+        log::debug("registering system '{}'", name);
+        s.init();
+        if constexpr (system::concepts::SystemWithUpdate<decltype(s)>)
+            schedule.add<A...>(name, s.update, priority);
+        system::manager.stop.push({name, s.stop});
+    }
+
+    //: simulation step
+    //      moves the updates registered with system::add into the schedule as exclusive systems, keeping their priority,
+    //      and runs every system once
+    inline void update() {
+        for (auto& manager = system::manager; not manager.update.empty(); manager.update.pop()) {
+            const auto& s = manager.update.top();
+            schedule.add<Exclusive>(s.name, s.f, s.priority);
+        }
+        schedule.run();
+    }
+}
@@ -0,0 +1,425 @@
+//* ecs_snapshot
+//      versioned binary snapshots of a sparse set scene, for fast level loads and restarts
+//      each component pool is written as a few raw arrays (sparse pages, dense indices and component data) aligned to 64 bytes in the file,
+//      so loading maps the file into memory and copies the arrays in bulk instead of adding entities one by one
+//          ecs::save_snapshot<Position, Velocity>(scene, "level.bin");
+//          ecs::load_snapshot<Position, Velocity>(other, "level.bin");
+//      only the listed components are saved or loaded, they must be trivially copyable and are stored with the native byte order
+//      snapshots are tied to the id layout and page size of the engine config, loading one written with a different config fails
+#pragma once
+
+#include "ecs.h"
+#include <cstring>
+#include <fstream>
+
+#if __has_include(<sys/mman.h>)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define FRESA_SNAPSHOT_MMAP
+#endif
+
+namespace fresa::ecs
+{
+    namespace concepts
+    {
+        //: components that can be written to a snapshot as raw bytes
+        template <typename T>
+        concept Snapshottable = std::is_trivially_copyable_v<T> and std::default_initializable<T>;
+    }
+
+    namespace detail
+    {
+        //: snapshot format version, increase it when the layout below changes
+        constexpr ui32 snapshot_format = 2;
+        constexpr std::size_t snapshot_alignment = 64;
+
+        //* snapshot layout
+        //      header, entities array (with the free list threaded through it), then one record per pool
+        //      a pool record is its header followed by the page numbers, the sparse pages, the dense array and one array per data column
+        //      (soa components have one column per field), every array starts at a 64 byte aligned offset
+        //      bytes is the size of the whole record, so pools that the loader doesn't ask for can be skipped
+        struct SnapshotHeader {
+            std::array<char, 8> magic = {'f', 'r', 'e', 's', 'a', 'e', 'c', 's'};
+            ui32 format = snapshot_format;
+            ui32 endian = 0x01020304;
+            ui32 index_bits = detail::index_bits;
+            ui32 version_bits = detail::version_bits;
+            ui32 page_size = SparseArray::page_size;
+            Tick tick = 0;
+            ui64 entities = 0;
+            ui64 free_list = 0;
+            ui64 pools = 0;
+        };
+
+        struct SnapshotPool {
+            ui64 type = 0;
+            ui64 bytes = 0;
+            ui64 size = 0;
+            ui64 pages = 0;
+            ui32 element_size = 0;
+            ui32 columns = 0;
+        };
+
+        //: element size of each data column, soa components have one column per field and tags have none
+        template <typename T>
+        [[nodiscard]] constexpr auto snapshot_columns() {
+            if constexpr (concepts::TagComponent<T>)
+                return std::array<std::size_t, 0>{};
+            else if constexpr (concepts::SoAComponent<T>)
+                return []<std::size_t ... I>(std::index_sequence<I...>) {
+                    return std::array{sizeof(typename SoAVector<T>::template field_t<I>)...};
+                }(std::make_index_sequence<SoAVector<T>::size_fields>());
+            else
+                return std::array{sizeof(T)};
+        }
+
+        //: contiguous segments of the data columns of a storage as (column, pointer, bytes), paged storage has one segment per page
+        template <typename T, typename F>
+        void for_each_segment(Storage<T>& data, F&& f) {
+            if constexpr (concepts::TagComponent<T>) {
+                return;
+            } else if constexpr (concepts::SoAComponent<T>) {
+                std::size_t c = 0;
+                std::apply([&](auto& ... column) { (f(c++, (void*)column.data(), column.size() * sizeof(column[0])), ...); }, data.columns);
+            } else if constexpr (concepts::PagedComponent<T>) {
+                constexpr std::size_t page_size = PagedVector<T>::page_size;
+                if (data.empty()) f(0, nullptr, 0);
+                for (std::size_t i = 0; i < data.size(); i += page_size) f(0, (void*)&data[i], std::min(page_size, data.size() - i) * sizeof(T));
+            } else {
+                f(0, (void*)data.data(), data.size() * sizeof(T));
+            }
+        }
+
+        //* snapshot writer
+        //      writes blobs to a file padding them to the snapshot alignment
+        struct SnapshotWriter {
+            std::ofstream file;
+            std::size_t offset = 0;
+
+            void write(const void* p, const std::size_t n) {
+                file.write(static_cast<const char*>(p), (std::streamsize)n);
+                offset += n;
+            }
+            void align() {
+                static constexpr std::array<char, snapshot_alignment> zero = {};
+                const auto padding = (snapshot_alignment - offset % snapshot_alignment) % snapshot_alignment;
+                write(zero.data(), padding);
+            }
+            void blob(const void* p, const std::size_t n) { align(); write(p, n); }
+        };
+
+        //* snapshot reader
+        //      maps a file into memory, or reads it into a buffer where mmap is not available, and hands out aligned blobs
+        //      blob returns nullptr if the file is too short, which the loader reports as a corrupt snapshot
+        struct SnapshotReader {
+            const std::byte* begin = nullptr;
+            std::size_t size = 0;
+            std::size_t offset = 0;
+            std::vector<std::byte> buffer;
+
+            explicit SnapshotReader(str_view path) {
+            #ifdef FRESA_SNAPSHOT_MMAP
+                const int fd = ::open(str(path).c_str(), O_RDONLY);
+                if (fd < 0) return;
+                struct stat info;
+                if (::fstat(fd, &info) == 0 and info.st_size > 0) {
+                    void* p = ::mmap(nullptr, (std::size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (p != MAP_FAILED) {
+                        begin = static_cast<const std::byte*>(p);
+                        size = (std::size_t)info.st_size;
+                        ::madvise(p, size, MADV_SEQUENTIAL);
+                    }
+                }
+                ::close(fd);
+            #else
+                std::ifstream file(str(path), std::ios::binary | std::ios::ate);
+                if (not file) return;
+                buffer.resize((std::size_t)file.tellg());
+                file.seekg(0);
+                file.read(reinterpret_cast<char*>(buffer.data()), (std::streamsize)buffer.size());
+                begin = buffer.data();
+                size = buffer.size();
+            #endif
+            }
+            ~SnapshotReader() {
+            #ifdef FRESA_SNAPSHOT_MMAP
+                if (begin != nullptr) ::munmap(const_cast<std::byte*>(begin), size);
+            #endif
+            }
+            SnapshotReader(const SnapshotReader&) = delete;
+            SnapshotReader& operator=(const SnapshotReader&) = delete;
+
+            [[nodiscard]] bool is_open() const noexcept { return begin != nullptr; }
+
+            [[nodiscard]] const std::byte* blob(const std::size_t n, const bool aligned = true) {
+                if (aligned) offset = (offset + snapshot_alignment - 1) / snapshot_alignment * snapshot_alignment;
+                if (offset > size or n > size - offset) return nullptr;
+                const auto p = begin + offset;
+                offset += n;
+                return p;
+            }
+        };
+
+        //: write the record of a pool
+        template <typename C>
+        void save_pool(SnapshotWriter& out, ComponentPool<C>& pool) {
+            std::vector<ui64> pages;
+            for (std::size_t i = 0; i < pool.sparse.pages.size(); i++) if (pool.sparse.find(i) != nullptr) pages.push_back(i);
+            SnapshotPool record{ .type = type_hash<C>().value, .bytes = 0, .size = pool.size(), .pages = pages.size(),
+                                 .element_size = sizeof(C), .columns = (ui32)snapshot_columns<C>().size() };
+            out.align();
+            const auto start = out.offset;
+            auto blobs = [&](auto&& blob, auto&& append) {
+                blob(pages.data(), pages.size() * sizeof(ui64));
+                for (auto p : pages) blob(pool.sparse.find(p)->data(), sizeof(SparseArray::Page));
+                blob(pool.dense.data(), pool.dense.size() * sizeof(Index));
+                //: the segments of a column are written back to back, so each column is a single blob
+                std::size_t column = snapshot_columns<C>().size();
+                for_each_segment<C>(pool.data, [&](std::size_t c, const void* p, std::size_t n) {
+                    if (c != column) blob(p, n); else append(p, n);
+                    column = c;
+                });
+            };
+
+            //: the record size is computed first by laying out the blobs without writing them
+            std::size_t end = start + sizeof(SnapshotPool);
+            blobs([&](const void*, std::size_t n) { end = (end + snapshot_alignment - 1) / snapshot_alignment * snapshot_alignment + n; },
+                  [&](const void*, std::size_t n) { end += n; });
+            record.bytes = end - start;
+
+            out.write(&record, sizeof(record));
+            blobs([&](const void* p, std::size_t n) { out.blob(p, n); }, [&](const void* p, std::size_t n) { out.write(p, n); });
+        }
+
+        //: pool record found in a snapshot, the blobs point into the mapped file
+        struct SnapshotRecord {
+            SnapshotPool header;
+            const std::byte* pages = nullptr;
+            std::vector<const std::byte*> sparse;
+            const std::byte* dense = nullptr;
+            std::vector<const std::byte*> columns;
+        };
+
+        //: read the blobs of a pool record, returns false if the file is too short or the page numbers are not increasing
+        //      every page is its own aligned blob, so a pointer is kept for each of them
+        inline bool read_pool(SnapshotReader& in, SnapshotRecord& r) {
+            constexpr std::size_t max_pages = max_entities / SparseArray::page_size + 1;
+            if (r.header.pages > max_pages or r.header.size > max_entities) return false;
+            r.pages = in.blob(r.header.pages * sizeof(ui64));
+            if (r.pages == nullptr) return false;
+            for (std::size_t i = 0; i < r.header.pages; i++) {
+                ui64 page = max_pages, previous = 0;
+                std::memcpy(&page, r.pages + i * sizeof(ui64), sizeof(ui64));
+                if (i > 0) std::memcpy(&previous, r.pages + (i - 1) * sizeof(ui64), sizeof(ui64));
+                if (page >= max_pages or (i > 0 and page <= previous)) return false;
+                r.sparse.push_back(in.blob(sizeof(SparseArray::Page)));
+                if (r.sparse.back() == nullptr) return false;
+            }
+            r.dense = in.blob(r.header.size * sizeof(Index));
+            return r.dense != nullptr;
+        }
+
+        //: check the entities array before it replaces the one of the scene
+        //      the free list must be a chain of distinct slots of the snapshot ending at max_entities, so recycling ids can't write out of
+        //      bounds or hand out the same index twice, and every other slot is alive and must hold its own index
+        inline bool validate_entities(const std::vector<EntityID>& entities, const ui64 free_list, std::vector<bool>& alive) {
+            alive.assign(entities.size(), true);
+            for (ui64 i = free_list, steps = 0; i != max_entities; i = index(entities[i]).value, steps++) {
+                if (i >= entities.size() or steps >= entities.size() or not alive[i]) return false;
+                alive[i] = false;
+            }
+            for (std::size_t i = 0; i < entities.size(); i++)
+                if (alive[i] and index(entities[i]).value != i) return false;
+            return true;
+        }
+
+        //: check that the sparse and dense arrays of a record are consistent before loading them
+        //      every used sparse entry must belong to an alive entity with the same version and point to a position below the size
+        //      that holds its own index, which with the sizes matching makes the sparse and dense arrays a bijection
+        inline bool validate_pool(const SnapshotRecord& r, const std::vector<EntityID>& entities, const std::vector<bool>& alive) {
+            std::vector<ui64> pages(r.header.pages);
+            for (std::size_t i = 0; i < pages.size(); i++) std::memcpy(&pages[i], r.pages + i * sizeof(ui64), sizeof(ui64));
+            const auto entry = [&](const std::size_t page, const std::size_t slot) {
+                ID sid;
+                std::memcpy(&sid, r.sparse[page] + slot * sizeof(ID), sizeof(ID));
+                return sid;
+            };
+
+            std::size_t used = 0;
+            for (std::size_t i = 0; i < pages.size(); i++) {
+                for (std::size_t slot = 0; slot < SparseArray::page_size; slot++) {
+                    const auto sid = entry(i, slot);
+                    if (sid == invalid_id) continue;
+                    const std::size_t e = pages[i] * SparseArray::page_size + slot;
+                    if (e >= entities.size() or not alive[e] or version(sid) != version(entities[e])) return false;
+                    const std::size_t pos = index(sid).value;
+                    if (pos >= r.header.size) return false;
+                    Index dense;
+                    std::memcpy(&dense, r.dense + pos * sizeof(Index), sizeof(Index));
+                    if (dense.value != e) return false;
+                    used++;
+                }
+            }
+            return used == r.header.size;
+        }
+
+        //: fill a pool from its record
+        //      the arrays are copied in bulk and the scene signatures are updated, which is the only per entity work
+        template <typename C>
+        void load_pool(Scene& scene, ComponentPool<C>& pool, const SnapshotRecord& r) {
+            const auto pages = reinterpret_cast<const ui64*>(r.pages);
+            for (std::size_t i = 0; i < r.header.pages; i++)
+                std::memcpy(pool.sparse.assure(pages[i]).data(), r.sparse[i], sizeof(SparseArray::Page));
+
+            pool.dense.resize(r.header.size);
+            std::memcpy(pool.dense.data(), r.dense, r.header.size * sizeof(Index));
+
+            pool.data.resize(r.header.size);
+            std::array<std::size_t, snapshot_columns<C>().size()> offsets = {};
+            for_each_segment<C>(pool.data, [&](std::size_t c, void* p, std::size_t n) {
+                if (n > 0) std::memcpy(p, r.columns[c] + offsets[c], n);
+                offsets[c] += n;
+            });
+
+            if (pool.buffered) pool.previous = pool.data;
+            if (pool.tracked) {
+                pool.added_ticks.assign(pool.size(), scene.tick);
+                pool.changed_ticks.assign(pool.size(), scene.tick);
+            }
+            for (const auto i : pool.dense) pool.sign(i.value);
+        }
+    }
+
+    //: save snapshot
+    //      writes the entities array, the tick and the pools of the listed components to a file, returns false on failure
+    //      pending reserved ids are committed first, the scene must not be modified while it is being saved
+    template <concepts::Snapshottable ... C>
+    bool save_snapshot(Scene& scene, str_view path) {
+        scene.commit_reserved();
+
+        detail::SnapshotWriter out{std::ofstream(str(path), std::ios::binary | std::ios::trunc)};
+        if (not out.file) {
+            log::error("could not open '{}' to save the scene snapshot", path);
+            return false;
+        }
+
+        detail::SnapshotHeader header{ .tick = scene.tick, .entities = scene.entities.size(), .free_list = scene.free_list, .pools = sizeof...(C) };
+        out.write(&header, sizeof(header));
+        out.blob(scene.entities.data(), scene.entities.size() * sizeof(EntityID));
+        (detail::save_pool<C>(out, scene.cpool<C>()), ...);
+
+        out.file.flush();
+        if (not out.file) {
+            log::error("could not write the scene snapshot to '{}'", path);
+            return false;
+        }
+        return true;
+    }
+
+    //: load snapshot
+    //      restores the pools of the listed components from a file into an empty scene, pools in the file that are not listed are skipped
+    //      the whole file is validated before the scene is modified, so on failure it is left untouched and false is returned
+    //      the entities array, free list and tick are replaced by the ones in the snapshot
+    template <concepts::Snapshottable ... C>
+    bool load_snapshot(Scene& scene, str_view path) {
+        detail::SnapshotReader in(path);
+        if (not in.is_open()) {
+            log::error("could not open the scene snapshot '{}'", path);
+            return false;
+        }
+
+        //: header, it must match the format and the id layout of this build
+        const auto h = in.blob(sizeof(detail::SnapshotHeader), false);
+        if (h == nullptr) {
+            log::error("'{}' is not a scene snapshot", path);
+            return false;
+        }
+        detail::SnapshotHeader header;
+        std::memcpy(&header, h, sizeof(header));
+        if (header.magic != detail::SnapshotHeader{}.magic) {
+            log::error("'{}' is not a scene snapshot", path);
+            return false;
+        }
+        if (header.format != detail::snapshot_format or header.endian != detail::SnapshotHeader{}.endian) {
+            log::error("the scene snapshot '{}' has format {}, expected {} (with the same byte order)", path, header.format, detail::snapshot_format);
+            return false;
+        }
+        if (header.index_bits != detail::index_bits or header.version_bits != detail::version_bits or header.page_size != detail::SparseArray::page_size) {
+            log::error("the scene snapshot '{}' was saved with a different entity id layout or page size", path);
+            return false;
+        }
+
+        //: entities and pool records
+        const auto blob = header.entities > max_entities ? nullptr : in.blob(header.entities * sizeof(EntityID));
+        if (blob == nullptr) {
+            log::error("the scene snapshot '{}' is corrupt", path);
+            return false;
+        }
+        std::vector<EntityID> entities(header.entities);
+        std::memcpy(entities.data(), blob, header.entities * sizeof(EntityID));
+        std::vector<bool> alive;
+        if (not detail::validate_entities(entities, header.free_list, alive)) {
+            log::error("the scene snapshot '{}' is corrupt", path);
+            return false;
+        }
+
+        std::vector<detail::SnapshotRecord> records;
+        for (std::size_t i = 0; i < header.pools; i++) {
+            const auto p = in.blob(sizeof(detail::SnapshotPool));
+            if (p == nullptr) {
+                log::error("the scene snapshot '{}' is corrupt", path);
+                return false;
+            }
+            detail::SnapshotRecord r;
+            std::memcpy(&r.header, p, sizeof(r.header));
+            const auto start = in.offset - sizeof(detail::SnapshotPool);
+
+            //: pools of the listed components are checked against this build and their blobs located, the rest are skipped
+            bool requested = false, matches = true;
+            (([&] {
+                if (r.header.type != type_hash<C>().value) return;
+                requested = true;
+                matches = r.header.element_size == sizeof(C) and r.header.columns == detail::snapshot_columns<C>().size();
+                if (not matches) {
+                    log::error("the layout of {} in the scene snapshot '{}' doesn't match this build", type_name<C>(), path);
+                    return;
+                }
+                if (not detail::read_pool(in, r) or not detail::validate_pool(r, entities, alive)) { r.columns.push_back(nullptr); return; }
+                for (auto n : detail::snapshot_columns<C>()) r.columns.push_back(in.blob(r.header.size * n));
+            }()), ...);
+            if (not matches) return false;
+            if (requested) {
+                if (std::find(r.columns.begin(), r.columns.end(), nullptr) != r.columns.end()) {
+                    log::error("the scene snapshot '{}' is corrupt", path);
+                    return false;
+                }
+                records.push_back(r);
+            }
+            in.offset = start + r.header.bytes;
+        }
+
+        //: only empty scenes can be loaded into, since the snapshot replaces the entity ids
+        bool empty = scene.reserved == 0 and scene.entities.empty();
+        for (const auto& [key, pool] : scene.component_pools) if (pool->size() > 0 or pool->group != nullptr) empty = false;
+        if (not empty) {
+            log::error("scene snapshots can only be loaded into an empty scene without groups");
+            return false;
+        }
+
+        //: everything is valid, fill the scene
+        scene.tick = header.tick;
+        for (auto& [key, pool] : scene.component_pools) pool->tick = scene.tick;
+        scene.entities = std::move(entities);
+        scene.free_list = header.free_list;
+        scene.signatures.reserve(scene.entities.size());
+
+        for (const auto& r : records)
+            (([&] { if (r.header.type == type_hash<C>().value) detail::load_pool<C>(scene, scene.cpool<C>(), r); }()), ...);
+
+        //: the pools are copied without notifying their queries, so they collect their matches again
+        for (auto& q : scene.queries) q->rebuild();
+        return true;
+    }
+}
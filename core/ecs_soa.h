@@ -0,0 +1,176 @@
+//* ecs_soa
+//      structure of arrays storage for component pools
+//      by default a pool stores its components in a std::vector<T>, which interleaves their fields (array of structures)
+//      components can opt in to a structure of arrays layout by specializing ecs::SoA with the list of their fields,
+//      then each field is stored in its own contiguous array aligned to a cache line, so loops over them can use wide simd loads
+//      (the columns use the allocator of ecs::Allocator<T> rebound to each field type if it is specialized, see ecs_storage.h)
+//          template <> struct fresa::ecs::SoA<Position> { static constexpr auto fields = std::tuple{&Position::x, &Position::y, &Position::z}; };
+//      elements are accessed through a proxy reference that reads and writes every field, and the field arrays are available as spans
+//          ref.field<&Position::x>() += 1.0f;                      // single field through a proxy
+//          for (auto& x : pool.data.field<&Position::x>()) ...     // whole column
+#pragma once
+
+#include "std_types.h"
+#include "constexpr_for.h"
+#include "ecs_storage.h"
+#include <span>
+
+namespace fresa::ecs
+{
+    //: soa trait, specialize it with a `fields` tuple of member pointers to store a component as a structure of arrays
+    template <typename T>
+    struct SoA {};
+
+    namespace concepts
+    {
+        template <typename T>
+        concept SoAComponent = std::default_initializable<T> and requires { std::tuple_size<std::remove_cvref_t<decltype(SoA<T>::fields)>>::value; };
+    }
+
+    namespace detail
+    {
+        template <typename T> struct SoAVector;
+
+        //* soa reference
+        //      proxy for an element of a soa vector, converts to and assigns from the component type
+        //      assigning a reference to another copies the values instead of rebinding, and swap exchanges the values
+        template <typename T>
+        struct SoARef {
+            SoAVector<T>* v;
+            std::size_t i;
+
+            //: field by index in the SoA<T>::fields tuple or by member pointer
+            template <std::size_t I>
+            [[nodiscard]] constexpr auto& get() const noexcept { return std::get<I>(v->columns)[i]; }
+            template <auto M>
+            [[nodiscard]] constexpr auto& field() const noexcept { return get<SoAVector<T>::template index_of<M>()>(); }
+
+            //: load and store the whole component
+            [[nodiscard]] constexpr operator T() const {
+                T value{};
+                for_<0, SoAVector<T>::size_fields>([&](auto I) { value.*std::get<I>(SoA<T>::fields) = get<I>(); });
+                return value;
+            }
+            constexpr const SoARef& operator=(const T& value) const {
+                for_<0, SoAVector<T>::size_fields>([&](auto I) { get<I>() = value.*std::get<I>(SoA<T>::fields); });
+                return *this;
+            }
+            constexpr const SoARef& operator=(const SoARef& other) const { return *this = T(other); }
+
+            friend constexpr void swap(SoARef a, SoARef b) {
+                for_<0, SoAVector<T>::size_fields>([&](auto I) { std::swap(a.get<I>(), b.get<I>()); });
+            }
+        };
+
+        //* soa pointer
+        //      what a soa pool returns instead of a pointer, it can be null, dereferences to a proxy reference,
+        //      and `->` reads a copy of the component so fields can be accessed by name (writes need the proxy)
+        template <typename T>
+        struct SoAPointer {
+            SoAVector<T>* v = nullptr;
+            std::size_t i = 0;
+
+            struct Arrow {
+                T value;
+                [[nodiscard]] constexpr const T* operator->() const noexcept { return &value; }
+            };
+
+            [[nodiscard]] constexpr SoARef<T> operator*() const noexcept { return {v, i}; }
+            [[nodiscard]] constexpr Arrow operator->() const { return {T(**this)}; }
+            [[nodiscard]] constexpr explicit operator bool() const noexcept { return v != nullptr; }
+            [[nodiscard]] constexpr bool operator==(std::nullptr_t) const noexcept { return v == nullptr; }
+        };
+
+        //* soa vector
+        //      stores each field of T in its own aligned std::vector, implementing the part of the std::vector interface the pools use
+        template <typename T>
+        struct SoAVector {
+            static constexpr std::size_t size_fields = std::tuple_size_v<std::remove_cvref_t<decltype(SoA<T>::fields)>>;
+            template <std::size_t I>
+            using field_t = std::remove_cvref_t<decltype(std::declval<T&>().*std::get<I>(SoA<T>::fields))>;
+
+            //: allocator of the component, rebound for each column
+            using allocator_type = typename allocator_of<T, AlignedAllocator<T>>::type;
+            template <typename F>
+            using column_allocator = typename std::allocator_traits<allocator_type>::template rebind_alloc<F>;
+
+            //: one column per field
+            [[nodiscard]] static constexpr auto make_columns() {
+                return []<std::size_t ... I>(std::index_sequence<I...>) {
+                    const auto allocator = make_allocator<allocator_type, T>();
+                    return std::tuple<std::vector<field_t<I>, column_allocator<field_t<I>>>...>{
+                        std::vector<field_t<I>, column_allocator<field_t<I>>>(column_allocator<field_t<I>>(allocator))...
+                    };
+                }(std::make_index_sequence<size_fields>());
+            }
+            decltype(make_columns()) columns = make_columns();
+
+            //: index of a member pointer in the fields tuple
+            template <auto M>
+            [[nodiscard]] static constexpr std::size_t index_of() {
+                std::size_t index = size_fields;
+                for_<0, size_fields>([&](auto I) {
+                    if constexpr (std::same_as<std::remove_cvref_t<decltype(std::get<I>(SoA<T>::fields))>, decltype(M)>)
+                        if (std::get<I>(SoA<T>::fields) == M) index = I;
+                });
+                return index;
+            }
+
+            //: column of a field as a span
+            template <auto M>
+            [[nodiscard]] constexpr auto field() noexcept { return std::span(std::get<index_of<M>()>(columns)); }
+
+            //: element access
+            [[nodiscard]] constexpr SoARef<T> operator[](const std::size_t i) noexcept { return {this, i}; }
+            [[nodiscard]] constexpr SoARef<T> at(const std::size_t i) {
+                if (i >= size()) throw std::out_of_range("soa vector index out of range");
+                return {this, i};
+            }
+
+            //: size
+            [[nodiscard]] constexpr std::size_t size() const noexcept { return std::get<0>(columns).size(); }
+            [[nodiscard]] constexpr std::size_t capacity() const noexcept { return std::get<0>(columns).capacity(); }
+            [[nodiscard]] constexpr bool empty() const noexcept { return size() == 0; }
+
+            //: modifiers, applied to every column
+            constexpr void emplace_back(const T& value) {
+                for_<0, size_fields>([&](auto I) { std::get<I>(columns).push_back(value.*std::get<I>(SoA<T>::fields)); });
+            }
+            constexpr void push_back(const T& value) { emplace_back(value); }
+            constexpr void resize(const std::size_t n, const T& value = T{}) {
+                for_<0, size_fields>([&](auto I) { std::get<I>(columns).resize(n, value.*std::get<I>(SoA<T>::fields)); });
+            }
+            constexpr void reserve(const std::size_t n) { std::apply([&](auto& ... c) { (c.reserve(n), ...); }, columns); }
+            constexpr void pop_back() { std::apply([](auto& ... c) { (c.pop_back(), ...); }, columns); }
+            constexpr void clear() noexcept { std::apply([](auto& ... c) { (c.clear(), ...); }, columns); }
+            constexpr void shrink_to_fit() { std::apply([](auto& ... c) { (c.shrink_to_fit(), ...); }, columns); }
+
+            //: iterator, yields proxy references
+            struct Iterator {
+                using iterator_category = std::forward_iterator_tag;
+                using value_type = T;
+                using difference_type = std::ptrdiff_t;
+
+                SoAVector* v;
+                std::size_t i;
+
+                [[nodiscard]] constexpr SoARef<T> operator*() const noexcept { return {v, i}; }
+                constexpr Iterator& operator++() noexcept { ++i; return *this; }
+                constexpr Iterator operator++(int) noexcept { auto it = *this; ++i; return it; }
+                [[nodiscard]] constexpr bool operator==(const Iterator& other) const noexcept { return i == other.i; }
+            };
+            [[nodiscard]] constexpr Iterator begin() const noexcept { return {const_cast<SoAVector*>(this), 0}; }
+            [[nodiscard]] constexpr Iterator end() const noexcept { return {const_cast<SoAVector*>(this), size()}; }
+        };
+
+        //: pointer to an element of a soa vector
+        template <typename T>
+        [[nodiscard]] constexpr SoAPointer<T> address(SoAVector<T>& v, const std::size_t i) noexcept { return {&v, i}; }
+
+        //: bytes allocated by a soa vector, the sum of its columns
+        template <typename T>
+        [[nodiscard]] constexpr std::size_t allocated_bytes(const SoAVector<T>& v) noexcept {
+            return std::apply([](const auto& ... c) { return ((c.capacity() * sizeof(typename std::remove_cvref_t<decltype(c)>::value_type)) + ... + 0); }, v.columns);
+        }
+    }
+}
@@ -0,0 +1,246 @@
+//* ecs_spatial
+//      uniform hash grid over the positions of a component pool, for range and neighbour queries without comparing every pair
+//      the position is the component itself if it is a Vec2 or Vec3 (or any floating point column vector of two or three elements),
+//      other components can point to one of their members by specializing ecs::Spatial
+//          template <> struct fresa::ecs::Spatial<Agent> { static constexpr auto position = &Agent::position; };
+//          ecs::SpatialGrid<Agent> grid(scene, 4.0f);
+//          grid.update(since);
+//          grid.query_radius(center, 10.0f, [&](ecs::EntityID e, const Vec2<float>& p) { ... });
+//      the grid is updated incrementally from the change tracking ticks of the pool, which it enables, so positions have to be
+//      modified with patch() or touch() to be picked up. removals are read from the pool removal log, so trim it with ticks older
+//      than the last update. choose a cell size close to the usual query radius, queries visit every cell their bounds overlap
+#pragma once
+
+#include "ecs.h"
+#include "fresa_math.h"
+#include <unordered_map>
+#include <queue>
+#include <cmath>
+
+namespace fresa::ecs
+{
+    //: spatial trait, specialize it with a `position` member pointer to index a component by one of its members
+    template <typename T>
+    struct Spatial {};
+
+    namespace concepts
+    {
+        template <typename V>
+        concept SpatialVector = fresa::concepts::ColumnVector<V> and (V::size().first == 2 or V::size().first == 3) and
+                                std::floating_point<typename V::value_type>;
+
+        template <typename T>
+        concept SpatialComponent = SpatialVector<T> or requires(const T& t) {
+            requires SpatialVector<std::remove_cvref_t<decltype(t.*Spatial<T>::position)>>;
+        };
+    }
+
+    namespace detail
+    {
+        //: position of a spatial component
+        template <concepts::SpatialComponent T>
+        [[nodiscard]] constexpr auto spatial_position(const T& value) {
+            if constexpr (concepts::SpatialVector<T>) return value;
+            else return std::remove_cvref_t<decltype(value.*Spatial<T>::position)>(value.*Spatial<T>::position);
+        }
+    }
+
+    //* spatial grid
+    //      every cell that contains entities is a bucket in a hash map, with the entity and a copy of its position so that queries
+    //      don't access the pool. each entity index has a slot with its cell and offset in the bucket, so moving an entity is O(1)
+    template <concepts::SpatialComponent C>
+    struct SpatialGrid {
+        using V = decltype(detail::spatial_position(std::declval<const C&>()));
+        using T = typename V::value_type;
+        static constexpr std::size_t dimensions = V::size().first;
+        using Cell = std::array<int, dimensions>;
+
+        struct Entry { EntityID entity; V position; };
+        struct Slot { EntityID entity = invalid_id; ui64 cell = 0; ui32 offset = 0; };
+
+        //: scene and pool
+        Scene* scene;
+        ComponentPool<C>* pool;
+
+        //: cells
+        T cell_size;
+        std::unordered_map<ui64, std::vector<Entry>> cells;
+        std::vector<Slot> slots;
+        std::size_t count = 0;
+
+        //: constructor
+        SpatialGrid(Scene& s, T size) : scene(&s), pool(&s.cpool<C>()), cell_size(size > T(0) ? size : T(1)) {
+            if (size <= T(0)) log::warn("the cell size of a spatial grid must be positive, using 1");
+            s.track<C>();
+        }
+
+        //: size
+        [[nodiscard]] constexpr std::size_t size() const noexcept { return count; }
+
+        //* update
+        //      removes the entities removed from the pool and moves the ones added or changed at or after `since`
+        //      calling it with 0 reinserts every entity of the pool
+        void update(const Tick since = 0) {
+            for (const auto entity : pool->removed_since(since)) {
+                const std::size_t i = index(entity).value;
+                if (i < slots.size() and slots[i].entity == entity) erase(i);
+            }
+            for (std::size_t pos = 0; pos < pool->size(); pos++) {
+                if (not pool->changed_since(pos, since)) continue;
+                const C value = pool->data[pos];
+                insert(pool->entity_at(pos), detail::spatial_position(value));
+            }
+        }
+
+        //: insert or move an entity
+        void insert(const EntityID entity, const V& position) {
+            const std::size_t i = index(entity).value;
+            if (i >= slots.size()) slots.resize(i + 1);
+            const auto key = hash(cell(position));
+            auto& slot = slots[i];
+            if (slot.entity == entity and slot.cell == key) { cells[key][slot.offset].position = position; return; }
+            if (slot.entity != invalid_id) erase(i);
+            auto& bucket = cells[key];
+            slots[i] = Slot{entity, key, ui32(bucket.size())};
+            bucket.push_back(Entry{entity, position});
+            count++;
+        }
+
+        //: remove an entity from the grid, swapping the last entry of its cell into its place
+        void erase(const std::size_t i) {
+            auto& slot = slots[i];
+            auto it = cells.find(slot.cell);
+            auto& bucket = it->second;
+            if (slot.offset + 1 < bucket.size()) {
+                bucket[slot.offset] = bucket.back();
+                slots[index(bucket[slot.offset].entity).value].offset = slot.offset;
+            }
+            bucket.pop_back();
+            if (bucket.empty()) cells.erase(it);
+            slot = Slot{};
+            count--;
+        }
+
+        //: clear
+        void clear() {
+            cells.clear();
+            slots.clear();
+            count = 0;
+        }
+
+        //* queries
+        //      they call f(entity, position) with the positions stored in the grid at the last update
+
+        //: entities inside an axis aligned box, bounds included
+        template <typename F> requires std::invocable<F, EntityID, const V&>
+        void query_aabb(const V& min, const V& max, F&& f) const {
+            each_cell(cell(min), cell(max), [&](const std::vector<Entry>& bucket) {
+                for (const auto& e : bucket) if (inside(e.position, min, max)) f(e.entity, e.position);
+            });
+        }
+
+        //: entities at a distance less or equal than radius from a point
+        template <typename F> requires std::invocable<F, EntityID, const V&>
+        void query_radius(const V& center, const T radius, F&& f) const {
+            V min = center, max = center;
+            for_<0, dimensions>([&](auto I) { min.template get<I, 0>() -= radius; max.template get<I, 0>() += radius; });
+            const T r2 = radius * radius;
+            each_cell(cell(min), cell(max), [&](const std::vector<Entry>& bucket) {
+                for (const auto& e : bucket) if (distance2(e.position, center) <= r2) f(e.entity, e.position);
+            });
+        }
+
+        //: the k nearest entities to a point, sorted by distance
+        //      visits rings of cells around the point until the farthest candidate is closer than the next ring
+        [[nodiscard]] std::vector<EntityID> nearest(const V& center, const std::size_t k) const {
+            using Candidate = std::pair<T, EntityID>;
+            constexpr auto farther = [](const Candidate& a, const Candidate& b) { return a.first < b.first; };
+            std::priority_queue<Candidate, std::vector<Candidate>, decltype(farther)> best(farther);
+            const auto consider = [&](const std::vector<Entry>& bucket) {
+                for (const auto& e : bucket) {
+                    const auto d = distance2(e.position, center);
+                    if (best.size() < k) best.emplace(d, e.entity);
+                    else if (d < best.top().first) { best.pop(); best.emplace(d, e.entity); }
+                }
+            };
+
+            if (k > 0 and count > 0) {
+                const auto c = cell(center);
+                for (int r = 0;; r++) {
+                    //: when the ring is larger than the occupied cells, checking all of them is cheaper
+                    if (std::pow(double(2 * r + 1), double(dimensions)) > double(cells.size())) {
+                        while (not best.empty()) best.pop();
+                        for (const auto& [key, bucket] : cells) consider(bucket);
+                        break;
+                    }
+                    Cell lo = c, hi = c;
+                    for (std::size_t d = 0; d < dimensions; d++) { lo[d] = std::max(lo[d] - r, -max_cell); hi[d] = std::min(hi[d] + r, max_cell); }
+                    each_cell(lo, hi, [&](const std::vector<Entry>& bucket) { consider(bucket); }, c, r);
+                    const T reach = T(r) * cell_size;
+                    if (best.size() == k and best.top().first <= reach * reach) break;
+                }
+            }
+
+            std::vector<EntityID> result(best.size());
+            for (auto i = result.size(); i-- > 0; best.pop()) result[i] = best.top().second;
+            return result;
+        }
+
+        //* cells
+
+        //: largest cell coordinate, the range [-max_cell, max_cell] has 2^21 - 1 values so each coordinate fits in 21 bits without aliasing
+        static constexpr int max_cell = (1 << 20) - 1;
+
+        //: cell coordinates of a position, clamped so that very far positions share the border cells instead of overflowing
+        [[nodiscard]] Cell cell(const V& position) const {
+            Cell c{};
+            for_<0, dimensions>([&](auto I) { c[I] = int(std::clamp(std::floor(position.template get<I, 0>() / cell_size), T(-max_cell), T(max_cell))); });
+            return c;
+        }
+
+        //: hash map key of a cell, packing the coordinates in 32 bits each for 2d and 21 bits each for 3d
+        //      the cell must be inside the clamped range, otherwise it would share its key with a cell on the opposite side
+        [[nodiscard]] static constexpr ui64 hash(const Cell& c) noexcept {
+            if constexpr (dimensions == 2) return (ui64(ui32(c[0])) << 32) | ui64(ui32(c[1]));
+            else return ((ui64(ui32(c[0])) & 0x1FFFFF) << 42) | ((ui64(ui32(c[1])) & 0x1FFFFF) << 21) | (ui64(ui32(c[2])) & 0x1FFFFF);
+        }
+
+        //: calls f(bucket) for the occupied cells in the box [lo, hi], only those at chebyshev distance `ring` from `center` if given
+        //      boxes with more cells than the occupied ones walk the hash map instead
+        template <typename F>
+        void each_cell(const Cell& lo, const Cell& hi, F&& f, const Cell& center = {}, const int ring = -1) const {
+            double volume = 1.0;
+            for (std::size_t d = 0; d < dimensions; d++) volume *= double(hi[d]) - double(lo[d]) + 1.0;
+            if (ring < 0 and volume > double(cells.size())) {
+                for (const auto& [key, bucket] : cells) f(bucket);
+                return;
+            }
+            Cell c = lo;
+            while (true) {
+                bool on_ring = ring < 0;
+                for (std::size_t d = 0; d < dimensions and not on_ring; d++) on_ring = std::abs(c[d] - center[d]) == ring;
+                if (on_ring) if (auto it = cells.find(hash(c)); it != cells.end()) f(it->second);
+                std::size_t d = 0;
+                for (; d < dimensions; d++) {
+                    if (c[d]++ < hi[d]) break;
+                    c[d] = lo[d];
+                }
+                if (d == dimensions) return;
+            }
+        }
+
+        [[nodiscard]] static constexpr T distance2(const V& a, const V& b) noexcept {
+            T d2 = T(0);
+            for_<0, dimensions>([&](auto I) { const T d = a.template get<I, 0>() - b.template get<I, 0>(); d2 += d * d; });
+            return d2;
+        }
+
+        [[nodiscard]] static constexpr bool inside(const V& p, const V& min, const V& max) noexcept {
+            bool result = true;
+            for_<0, dimensions>([&](auto I) {
+                result = result and p.template get<I, 0>() >= min.template get<I, 0>() and p.template get<I, 0>() <= max.template get<I, 0>();
+            });
+            return result;
+        }
+    };
+}
@@ -0,0 +1,384 @@
+//* ecs_storage
+//      allocators and storage options for component pools
+//      the components of a pool are allocated with ecs::Allocator<T>, which defaults to std::allocator (or a cache line aligned
+//      allocator for soa components). specialize it to use a pmr resource, an arena or huge pages for a component type
+//          template <> struct fresa::ecs::Allocator<Position> {
+//              using type = std::pmr::polymorphic_allocator<Position>;
+//              static type get() { return &arena; }     // optional, the allocator is default constructed otherwise
+//          };
+//      a std::vector reallocates and copies every component when it grows, which causes frame spikes and invalidates pointers
+//      components can opt in to paged storage by specializing ecs::Paged with a page size (number of components per page, a power of two)
+//          template <> struct fresa::ecs::Paged<Position> { static constexpr std::size_t page_size = 4096; };
+//      paged storage allocates fixed pages as it grows and never moves the components already stored, so pointers returned by get()
+//      stay valid while the pool grows. removing entities still moves the last component of the pool into the removed slot,
+//      and sorting or grouping the pool reorders them
+//      empty types are tags, pools of tags only keep the sparse set and a count of their components, without a data array
+//          struct Burning {};
+//          scene.add(entity, Burning{});
+//          for (auto [e, p] : View<Position, Burning>(scene)) ...   // views, groups and queries don't yield tags
+#pragma once
+
+#include "std_types.h"
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <iterator>
+#include <bit>
+
+#if __has_include(<sys/mman.h>)
+#include <sys/mman.h>
+#define FRESA_HUGE_PAGES
+#endif
+
+namespace fresa::ecs
+{
+    //: allocator trait, specialize it with a `type` allocator (and optionally a static `get()` that returns an instance of it)
+    template <typename T>
+    struct Allocator {};
+
+    //: paged storage trait, specialize it with a `page_size` to store a component in pages that never move
+    template <typename T>
+    struct Paged {};
+
+    namespace concepts
+    {
+        template <typename T>
+        concept PagedComponent = requires { { Paged<T>::page_size } -> std::convertible_to<std::size_t>; };
+
+        template <typename T>
+        concept TagComponent = std::is_empty_v<T> and std::default_initializable<T>;
+    }
+
+    namespace detail
+    {
+        //: allocator that aligns the allocations to a cache line
+        template <typename T>
+        struct AlignedAllocator {
+            using value_type = T;
+            static constexpr std::align_val_t alignment{64};
+
+            AlignedAllocator() = default;
+            template <typename U> constexpr AlignedAllocator(const AlignedAllocator<U>&) noexcept {}
+
+            [[nodiscard]] T* allocate(const std::size_t n) { return static_cast<T*>(::operator new(n * sizeof(T), alignment)); }
+            void deallocate(T* p, const std::size_t n) noexcept { ::operator delete(p, n * sizeof(T), alignment); }
+
+            template <typename U> bool operator==(const AlignedAllocator<U>&) const noexcept { return true; }
+        };
+
+        //: allocator type of a component, the trait if it is specialized or the given default
+        template <typename T, typename Default>
+        struct allocator_of { using type = Default; };
+        template <typename T, typename Default> requires requires { typename Allocator<T>::type; }
+        struct allocator_of<T, Default> { using type = typename Allocator<T>::type; };
+
+        //: allocator instance of a component, from the trait if it provides one
+        template <typename A, typename T>
+        [[nodiscard]] A make_allocator() {
+            if constexpr (requires { { Allocator<T>::get() } -> std::convertible_to<A>; }) return Allocator<T>::get();
+            else return A();
+        }
+    }
+
+    //* huge page allocator
+    //      allocations of at least huge_page_size bytes are mapped directly and rounded up to whole huge pages, which reduces tlb misses
+    //      when iterating large pools. it first asks for explicit huge pages and falls back to transparent huge pages if there are none
+    //      reserved, smaller allocations and platforms without mmap use aligned operator new
+    //      pair it with paged storage and a page size that fills a huge page, so every page of the pool is one huge page
+    template <typename T>
+    struct HugePageAllocator {
+        using value_type = T;
+        static constexpr std::size_t huge_page_size = 1 << 21;
+        static constexpr std::align_val_t alignment{64};
+
+        HugePageAllocator() = default;
+        template <typename U> constexpr HugePageAllocator(const HugePageAllocator<U>&) noexcept {}
+
+        [[nodiscard]] static constexpr std::size_t mapped_size(const std::size_t n) noexcept {
+            return (n * sizeof(T) + huge_page_size - 1) / huge_page_size * huge_page_size;
+        }
+
+        [[nodiscard]] T* allocate(const std::size_t n) {
+        #ifdef FRESA_HUGE_PAGES
+            if (n * sizeof(T) >= huge_page_size) {
+                const auto bytes = mapped_size(n);
+                void* p = MAP_FAILED;
+            #ifdef MAP_HUGETLB
+                p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            #endif
+                if (p == MAP_FAILED) {
+                    //: transparent huge pages need the mapping to be aligned to a huge page, so map one more and trim both ends
+                    auto q = static_cast<std::byte*>(::mmap(nullptr, bytes + huge_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+                    if (q == MAP_FAILED) throw std::bad_alloc();
+                    const auto head = (huge_page_size - reinterpret_cast<std::uintptr_t>(q) % huge_page_size) % huge_page_size;
+                    if (head > 0) ::munmap(q, head);
+                    if (head < huge_page_size) ::munmap(q + head + bytes, huge_page_size - head);
+                    p = q + head;
+                #ifdef MADV_HUGEPAGE
+                    ::madvise(p, bytes, MADV_HUGEPAGE);
+                #endif
+                }
+                return static_cast<T*>(p);
+            }
+        #endif
+            return static_cast<T*>(::operator new(n * sizeof(T), alignment));
+        }
+
+        void deallocate(T* p, const std::size_t n) noexcept {
+        #ifdef FRESA_HUGE_PAGES
+            if (n * sizeof(T) >= huge_page_size) { ::munmap(p, mapped_size(n)); return; }
+        #endif
+            ::operator delete(p, n * sizeof(T), alignment);
+        }
+
+        template <typename U> bool operator==(const HugePageAllocator<U>&) const noexcept { return true; }
+    };
+
+    namespace detail
+    {
+        //* paged vector
+        //      stores elements in fixed size pages that are allocated as needed and never reallocated, so elements don't move when it grows
+        //      implements the part of the std::vector interface the pools use, pages are kept on clear to be reused
+        template <typename T>
+        struct PagedVector {
+            static constexpr std::size_t page_size = Paged<T>::page_size;
+            static_assert(std::has_single_bit(page_size), "the page size of paged storage must be a power of two");
+            static constexpr std::size_t page_shift = std::countr_zero(page_size);
+
+            using allocator_type = typename allocator_of<T, std::allocator<T>>::type;
+            using traits = std::allocator_traits<allocator_type>;
+
+            allocator_type allocator = make_allocator<allocator_type, T>();
+            std::vector<T*> pages;
+            std::size_t count = 0;
+
+            //: constructors, copying copies the elements into new pages
+            PagedVector() = default;
+            explicit PagedVector(const allocator_type& allocator) : allocator(allocator) {}
+            PagedVector(const PagedVector& other) : allocator(traits::select_on_container_copy_construction(other.allocator)) {
+                reserve(other.size());
+                for (const auto& value : other) emplace_back(value);
+            }
+            PagedVector(PagedVector&& other) noexcept : allocator(std::move(other.allocator)), pages(std::move(other.pages)), count(other.count) {
+                other.pages.clear();
+                other.count = 0;
+            }
+            ~PagedVector() { release(); }
+
+            //: assignment, follows the propagation traits of the allocator like std::vector
+            //      allocators that are not propagated are kept (some, like std::pmr::polymorphic_allocator, can't be assigned),
+            //      and moving from a different allocator moves the elements one by one into pages of this one
+            PagedVector& operator=(const PagedVector& other) {
+                if (this == &other) return *this;
+                if constexpr (traits::propagate_on_container_copy_assignment::value) {
+                    if (allocator != other.allocator) release();
+                    allocator = other.allocator;
+                }
+                clear();
+                reserve(other.size());
+                for (const auto& value : other) emplace_back(value);
+                return *this;
+            }
+            PagedVector& operator=(PagedVector&& other) noexcept(traits::propagate_on_container_move_assignment::value or traits::is_always_equal::value) {
+                if (this == &other) return *this;
+                if constexpr (traits::propagate_on_container_move_assignment::value or traits::is_always_equal::value) {
+                    release();
+                    if constexpr (traits::propagate_on_container_move_assignment::value) allocator = std::move(other.allocator);
+                    pages = std::exchange(other.pages, {});
+                    count = std::exchange(other.count, 0);
+                } else if (allocator == other.allocator) {
+                    release();
+                    pages = std::exchange(other.pages, {});
+                    count = std::exchange(other.count, 0);
+                } else {
+                    clear();
+                    reserve(other.size());
+                    for (auto& value : other) emplace_back(std::move(value));
+                    other.clear();
+                }
+                return *this;
+            }
+
+            //: element access
+            [[nodiscard]] constexpr T& operator[](const std::size_t i) noexcept { return pages[i >> page_shift][i & (page_size - 1)]; }
+            [[nodiscard]] constexpr const T& operator[](const std::size_t i) const noexcept { return pages[i >> page_shift][i & (page_size - 1)]; }
+            [[nodiscard]] constexpr T& at(const std::size_t i) {
+                if (i >= size()) throw std::out_of_range("paged vector index out of range");
+                return (*this)[i];
+            }
+            [[nodiscard]] constexpr T& back() noexcept { return (*this)[count - 1]; }
+
+            //: size
+            [[nodiscard]] constexpr std::size_t size() const noexcept { return count; }
+            [[nodiscard]] constexpr std::size_t capacity() const noexcept { return pages.size() * page_size; }
+            [[nodiscard]] constexpr bool empty() const noexcept { return count == 0; }
+
+            //: modifiers
+            template <typename ... Args>
+            constexpr T& emplace_back(Args&& ... args) {
+                if (count == capacity()) pages.push_back(traits::allocate(allocator, page_size));
+                traits::construct(allocator, &(*this)[count], std::forward<Args>(args)...);
+                return (*this)[count++];
+            }
+            constexpr void push_back(const T& value) { emplace_back(value); }
+            constexpr void push_back(T&& value) { emplace_back(std::move(value)); }
+            constexpr void pop_back() { traits::destroy(allocator, &(*this)[--count]); }
+            constexpr void resize(const std::size_t n, const T& value = T{}) {
+                reserve(n);
+                while (count > n) pop_back();
+                while (count < n) emplace_back(value);
+            }
+            constexpr void reserve(const std::size_t n) {
+                while (capacity() < n) pages.push_back(traits::allocate(allocator, page_size));
+            }
+            constexpr void clear() noexcept { while (count > 0) pop_back(); }
+
+            //: destroys the elements and returns every page to the allocator
+            constexpr void release() noexcept {
+                clear();
+                for (auto p : pages) traits::deallocate(allocator, p, page_size);
+                pages.clear();
+            }
+
+            //: releases the pages past the last element, the remaining elements don't move
+            constexpr void shrink_to_fit() {
+                const auto used = (count + page_size - 1) >> page_shift;
+                while (pages.size() > used) { traits::deallocate(allocator, pages.back(), page_size); pages.pop_back(); }
+                pages.shrink_to_fit();
+            }
+
+            //: iterator, random access over the pages
+            template <bool Const>
+            struct Iterator {
+                using iterator_category = std::random_access_iterator_tag;
+                using value_type = T;
+                using difference_type = std::ptrdiff_t;
+                using reference = std::conditional_t<Const, const T&, T&>;
+                using pointer = std::conditional_t<Const, const T*, T*>;
+
+                std::conditional_t<Const, const PagedVector*, PagedVector*> v = nullptr;
+                std::size_t i = 0;
+
+                [[nodiscard]] constexpr reference operator*() const noexcept { return (*v)[i]; }
+                [[nodiscard]] constexpr pointer operator->() const noexcept { return &(*v)[i]; }
+                [[nodiscard]] constexpr reference operator[](const difference_type n) const noexcept { return (*v)[i + n]; }
+                constexpr Iterator& operator++() noexcept { ++i; return *this; }
+                constexpr Iterator operator++(int) noexcept { auto it = *this; ++i; return it; }
+                constexpr Iterator& operator--() noexcept { --i; return *this; }
+                constexpr Iterator operator--(int) noexcept { auto it = *this; --i; return it; }
+                constexpr Iterator& operator+=(const difference_type n) noexcept { i += n; return *this; }
+                constexpr Iterator& operator-=(const difference_type n) noexcept { i -= n; return *this; }
+                [[nodiscard]] constexpr Iterator operator+(const difference_type n) const noexcept { return {v, i + n}; }
+                [[nodiscard]] constexpr Iterator operator-(const difference_type n) const noexcept { return {v, i - n}; }
+                [[nodiscard]] friend constexpr Iterator operator+(const difference_type n, const Iterator& it) noexcept { return it + n; }
+                [[nodiscard]] constexpr difference_type operator-(const Iterator& other) const noexcept { return difference_type(i) - difference_type(other.i); }
+                [[nodiscard]] constexpr bool operator==(const Iterator& other) const noexcept { return i == other.i; }
+                [[nodiscard]] constexpr auto operator<=>(const Iterator& other) const noexcept { return i <=> other.i; }
+            };
+            [[nodiscard]] constexpr Iterator<false> begin() noexcept { return {this, 0}; }
+            [[nodiscard]] constexpr Iterator<false> end() noexcept { return {this, count}; }
+            [[nodiscard]] constexpr Iterator<true> begin() const noexcept { return {this, 0}; }
+            [[nodiscard]] constexpr Iterator<true> end() const noexcept { return {this, count}; }
+            [[nodiscard]] constexpr Iterator<true> cbegin() const noexcept { return begin(); }
+            [[nodiscard]] constexpr Iterator<true> cend() const noexcept { return end(); }
+            [[nodiscard]] constexpr auto rbegin() const noexcept { return std::reverse_iterator(end()); }
+            [[nodiscard]] constexpr auto rend() const noexcept { return std::reverse_iterator(begin()); }
+            [[nodiscard]] constexpr auto crbegin() const noexcept { return rbegin(); }
+            [[nodiscard]] constexpr auto crend() const noexcept { return rend(); }
+        };
+
+        //: pointer to an element of a paged vector
+        template <typename T>
+        [[nodiscard]] constexpr T* address(PagedVector<T>& v, const std::size_t i) noexcept { return &v[i]; }
+
+        //: reserve room for n more elements, pages never move so they are added exactly as needed
+        template <typename T>
+        constexpr void reserve_more(PagedVector<T>& v, const std::size_t n) { v.reserve(v.size() + n); }
+
+        //: bytes allocated by a paged vector, pages and page pointers
+        template <typename T>
+        [[nodiscard]] constexpr std::size_t allocated_bytes(const PagedVector<T>& v) noexcept {
+            return v.capacity() * sizeof(T) + v.pages.capacity() * sizeof(T*);
+        }
+
+        //* tag vector
+        //      storage for empty components, every element is the same shared instance, so it only counts them
+        //      implements the part of the std::vector interface the pools use, its iterators yield the shared instance count times
+        template <typename T>
+        struct TagVector {
+            static_assert(concepts::TagComponent<T>, "tag storage is only for empty types");
+            static inline T value{};
+            std::size_t count = 0;
+
+            //: element access
+            [[nodiscard]] constexpr T& operator[](const std::size_t) const noexcept { return value; }
+            [[nodiscard]] constexpr T& at(const std::size_t i) const {
+                if (i >= count) throw std::out_of_range("tag vector index out of range");
+                return value;
+            }
+            [[nodiscard]] constexpr T& back() const noexcept { return value; }
+
+            //: size
+            [[nodiscard]] constexpr std::size_t size() const noexcept { return count; }
+            [[nodiscard]] constexpr std::size_t capacity() const noexcept { return count; }
+            [[nodiscard]] constexpr bool empty() const noexcept { return count == 0; }
+
+            //: modifiers
+            template <typename ... Args>
+            constexpr T& emplace_back(Args&& ...) noexcept { count++; return value; }
+            constexpr void push_back(const T&) noexcept { count++; }
+            constexpr void pop_back() noexcept { count--; }
+            constexpr void resize(const std::size_t n, const T& = T{}) noexcept { count = n; }
+            constexpr void reserve(const std::size_t) noexcept {}
+            constexpr void clear() noexcept { count = 0; }
+            constexpr void shrink_to_fit() noexcept {}
+
+            //: iterator, random access over the positions, every one refers to the shared instance
+            template <bool Const>
+            struct Iterator {
+                using iterator_category = std::random_access_iterator_tag;
+                using value_type = T;
+                using difference_type = std::ptrdiff_t;
+                using reference = std::conditional_t<Const, const T&, T&>;
+                using pointer = std::conditional_t<Const, const T*, T*>;
+
+                std::size_t i = 0;
+
+                [[nodiscard]] constexpr reference operator*() const noexcept { return value; }
+                [[nodiscard]] constexpr pointer operator->() const noexcept { return &value; }
+                [[nodiscard]] constexpr reference operator[](const difference_type) const noexcept { return value; }
+                constexpr Iterator& operator++() noexcept { ++i; return *this; }
+                constexpr Iterator operator++(int) noexcept { auto it = *this; ++i; return it; }
+                constexpr Iterator& operator--() noexcept { --i; return *this; }
+                constexpr Iterator operator--(int) noexcept { auto it = *this; --i; return it; }
+                constexpr Iterator& operator+=(const difference_type n) noexcept { i += n; return *this; }
+                constexpr Iterator& operator-=(const difference_type n) noexcept { i -= n; return *this; }
+                [[nodiscard]] constexpr Iterator operator+(const difference_type n) const noexcept { return {i + n}; }
+                [[nodiscard]] constexpr Iterator operator-(const difference_type n) const noexcept { return {i - n}; }
+                [[nodiscard]] friend constexpr Iterator operator+(const difference_type n, const Iterator& it) noexcept { return it + n; }
+                [[nodiscard]] constexpr difference_type operator-(const Iterator& other) const noexcept { return difference_type(i) - difference_type(other.i); }
+                [[nodiscard]] constexpr bool operator==(const Iterator& other) const noexcept { return i == other.i; }
+                [[nodiscard]] constexpr auto operator<=>(const Iterator& other) const noexcept { return i <=> other.i; }
+            };
+            [[nodiscard]] constexpr Iterator<false> begin() noexcept { return {0}; }
+            [[nodiscard]] constexpr Iterator<false> end() noexcept { return {count}; }
+            [[nodiscard]] constexpr Iterator<true> begin() const noexcept { return {0}; }
+            [[nodiscard]] constexpr Iterator<true> end() const noexcept { return {count}; }
+            [[nodiscard]] constexpr Iterator<true> cbegin() const noexcept { return begin(); }
+            [[nodiscard]] constexpr Iterator<true> cend() const noexcept { return end(); }
+            [[nodiscard]] constexpr auto rbegin() const noexcept { return std::reverse_iterator(end()); }
+            [[nodiscard]] constexpr auto rend() const noexcept { return std::reverse_iterator(begin()); }
+            [[nodiscard]] constexpr auto crbegin() const noexcept { return rbegin(); }
+            [[nodiscard]] constexpr auto crend() const noexcept { return rend(); }
+        };
+
+        //: pointer to an element of a tag vector, the shared instance
+        template <typename T>
+        [[nodiscard]] constexpr T* address(TagVector<T>&, const std::size_t) noexcept { return &TagVector<T>::value; }
+
+        //: tag vectors don't allocate
+        template <typename T>
+        [[nodiscard]] constexpr std::size_t allocated_bytes(const TagVector<T>&) noexcept { return 0; }
+    }
+}
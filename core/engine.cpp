@@ -11,6 +11,7 @@
 #include "fresa_config.h"
 #include "system.h"
 #include "jobs.h"
+#include "ecs_schedule.h"
 
 using namespace fresa;
 
@@ -81,7 +82,8 @@ bool fresa::detail::update() {
 
     //: update the simulation with discrete steps
     while (accumulator >= dt) {
-        //- simulation(t, dt)
+        //: run the systems, concurrently when they declare their component access (see ecs_schedule.h)
+        ecs::update();
 
         accumulator -= dt;
         simulation_time += dt;
@@ -91,9 +93,10 @@ bool fresa::detail::update() {
             return false;
     }
 
-    //? interpolation
-    //      const double alpha = std::chrono::duration<double>{accumulator} / dt;
-    //      state = current * alpha + previous * (1.0 - alpha);
+    //: interpolation
+    //      how far the frame is between the last simulation step and the next one, used to blend the buffered state
+    //      state = previous * (1.0 - alpha) + current * alpha
+    interpolation_alpha = std::chrono::duration<double>{accumulator} / dt;
 
     return true;
 }
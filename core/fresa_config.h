@@ -34,8 +34,15 @@ namespace fresa
         constexpr str_view virtual run_tests() const { return ""; };
         //: log level (see tools/log.h for the list of levels)
         constexpr ui32 virtual log_level() const { return 0b0000111; };
+        //: entity id layout, number of bits for the index and the version
+        constexpr ui32 virtual ecs_index_bits() const { return 16; };
+        constexpr ui32 virtual ecs_version_bits() const { return 16; };
         //: component pool page size
         constexpr ui32 virtual ecs_page_size() const { return 256; };
+        //: archetype chunk size in bytes
+        constexpr ui32 virtual ecs_chunk_size() const { return 16384; };
+        //: maximum number of component types with a signature bit, types past it fall back to visiting their pool
+        constexpr ui32 virtual ecs_max_components() const { return 128; };
     };
 
     //* run config (run time)
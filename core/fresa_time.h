@@ -18,4 +18,9 @@ namespace fresa
     //* fixed delta time for updates, new simulation each 1/N seconds
     auto constexpr update_frequency = 100;
     auto constexpr dt = std::chrono::duration<ui64, std::ratio<1, update_frequency>>(1);
+
+    //* interpolation factor between the last two simulation steps, updated every frame by the engine loop
+    //      0 is the previous step and 1 the current one, renderers use it to blend double buffered components (see ecs::Interpolated)
+    //      scenes with buffered components must call Scene::store() at the start of each step (see docs/reference/time.md)
+    inline double interpolation_alpha = 0.0;
 }
\ No newline at end of file
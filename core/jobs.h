@@ -236,16 +236,18 @@ namespace fresa::jobs
             if (thread_count == 0)
                 thread_count = 1;
 
-            //: create threads and queues
+            //: create queues, they must exist before any thread starts since threads access all of them to steal jobs
             for (ui32 i = 0; i < thread_count; i++) {
-                thread_pool.push_back(std::jthread(JobSystem::thread_run, i));
-
                 global_queues.emplace_back(AtomicQueue<JobPromiseBase*>());
                 local_queues.emplace_back(AtomicQueue<JobPromiseBase*>());
 
                 thread_cv.emplace_back(std::make_unique<std::condition_variable>());
                 thread_mutex.emplace_back(std::make_unique<std::mutex>());
             }
+
+            //: create threads
+            for (ui32 i = 0; i < thread_count; i++)
+                thread_pool.push_back(std::jthread(JobSystem::thread_run, i));
         }
 
         //: schedule job
@@ -275,7 +277,8 @@ namespace fresa::jobs
             //: counter for the number of threads initialized
             //      it is written like this to allow for system recreation (stop and init again)
             static std::atomic<ui32> thread_counter = 0;
-            if (thread_counter == 0) thread_counter = thread_count.load();
+            ui32 expected = 0;
+            thread_counter.compare_exchange_strong(expected, thread_count.load());
 
             //: wait for all threads to be available
             thread_counter--;
@@ -299,8 +302,7 @@ namespace fresa::jobs
                     current_job = global_queues[thread_index].pop();
 
                 //: if there is no job, try to steal one from another thread
-                ui32 n = thread_count - 1;
-                while (not current_job.has_value() and --n > 0) {
+                for (ui32 n = 1; not current_job.has_value() and n < thread_count; n++) {
                     steal_next = (steal_next + 1) % thread_count;
                     current_job = global_queues[steal_next].pop();
                 }
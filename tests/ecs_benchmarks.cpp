@@ -0,0 +1,714 @@
+//* ecs_benchmarks
+//      performance measurements for the entity component system
+//      they are regular test suites, so add them to run_tests() in the engine config, ideally on an optimized build
+//      the default config holds up to 65535 entities, ecs_benchmarks_config.h widens the entity index so every size runs
+#ifdef FRESA_ENABLE_TESTS
+
+#include "unit_test.h"
+#include "ecs.h"
+#include "ecs_archetype.h"
+#include "ecs_commands.h"
+#include "ecs_snapshot.h"
+#include "ecs_hierarchy.h"
+#include "ecs_spatial.h"
+#include "ecs_schedule.h"
+#include "fresa_time.h"
+#include "system.h"
+#include <numeric>
+#include <filesystem>
+
+namespace test::detail
+{
+    //: same components stored as structures of arrays
+    struct SoAPosition { float x, y, z; };
+    struct SoAVelocity { float x, y, z; };
+
+    //: same component stored in pages
+    struct PagedPosition { float x, y, z; };
+
+    //: position with the arithmetic operators used by the default interpolation
+    struct Transform {
+        float x, y, z;
+        friend Transform operator+(const Transform& a, const Transform& b) { return {a.x + b.x, a.y + b.y, a.z + b.z}; }
+        friend Transform operator-(const Transform& a, const Transform& b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+        friend Transform operator*(const Transform& a, float t) { return {a.x * t, a.y * t, a.z * t}; }
+    };
+}
+template <> struct fresa::ecs::SoA<test::detail::SoAPosition> {
+    static constexpr auto fields = std::tuple{&test::detail::SoAPosition::x, &test::detail::SoAPosition::y, &test::detail::SoAPosition::z};
+};
+template <> struct fresa::ecs::SoA<test::detail::SoAVelocity> {
+    static constexpr auto fields = std::tuple{&test::detail::SoAVelocity::x, &test::detail::SoAVelocity::y, &test::detail::SoAVelocity::z};
+};
+template <> struct fresa::ecs::Paged<test::detail::PagedPosition> { static constexpr std::size_t page_size = 4096; };
+
+namespace test
+{
+    using namespace fresa;
+
+    namespace detail
+    {
+        //: benchmark components
+        struct Position { float x, y, z; };
+        struct Velocity { float x, y, z; };
+        struct Collider { float radius; };
+        struct Layer { ui32 value; };
+        template <std::size_t N> struct Filler { float value; };
+        struct Burning { float heat; };
+        struct Flammable { float fuel; };
+        struct Selected {};
+
+        //: number of entities, limited by the entity index bits of the engine config
+        constexpr std::size_t requested_entities = 100000;
+        constexpr std::size_t entity_count = std::min<std::size_t>(requested_entities, ecs::max_entities);
+
+        //: warns once if the entity count was clamped, since every result afterwards uses fewer entities than requested
+        inline void log_entity_count() {
+            static bool logged = false;
+            if (entity_count < requested_entities and not std::exchange(logged, true))
+                log::warn("the ecs benchmarks use {} entities instead of {}, build them with ecs_benchmarks_config.h for more ecs_index_bits()", entity_count, requested_entities);
+        }
+
+        //: benchmark
+        //      runs the function once and logs the time it took divided by the number of operations
+        template <typename F>
+        void benchmark(str_view name, std::size_t n, F&& f) {
+            log_entity_count();
+            const auto start = time();
+            f();
+            const auto ns = std::chrono::duration<double, std::nano>(time() - start).count();
+            fresa::detail::log<"BENCHMARK", LOG_TEST | LOG_DEBUG, fmt::color::plum>("{}: {:.2f} ns/entity ({} entities)", name, ns / n, n);
+        }
+    }
+
+    inline TestSuite ecs_entity_benchmarks("ecs_entity_benchmarks", []{
+        using namespace detail;
+
+        //: the id layout is a compile time option, so run this suite with different ecs_index_bits() and ecs_version_bits()
+        constexpr std::size_t n = entity_count;
+        fresa::detail::log<"BENCHMARK", LOG_TEST | LOG_DEBUG, fmt::color::plum>("entity id layout: {} index bits, {} version bits, {} bytes per id",
+                                                                              ecs::detail::index_bits, ecs::detail::version_bits, sizeof(ecs::EntityID));
+        ecs::Scene scene;
+        std::vector<ecs::EntityID> entities;
+        benchmark("scene add", n, [&]{
+            for (std::size_t i = 0; i < n; i++) entities.push_back(scene.add(Position{1.0f, 1.0f, 1.0f}));
+        });
+
+        "memory per entity"_test = [&]{
+            const auto m = scene.cpool<Position>().memory();
+            fresa::detail::log<"BENCHMARK", LOG_TEST | LOG_DEBUG, fmt::color::plum>("sparse {:.2f} bytes/entity, dense {:.2f} bytes/entity, data {:.2f} bytes/entity",
+                                                                                  (double)m.sparse_bytes / n, (double)m.dense_bytes / n, (double)m.data_bytes / n);
+            return expect(m.entities == n);
+        };
+
+        "random access"_test = [&]{
+            //: visit the entities in a scattered order using a stride coprime with the number of entities
+            std::size_t stride = 7919;
+            while (std::gcd(stride, n) != 1) stride++;
+            float sum = 0.0f;
+            benchmark("scene get (scattered)", n, [&]{
+                for (std::size_t i = 0, j = 0; i < n; i++, j = (j + stride) % n) sum += scene.get<Position>(entities[j])->x;
+            });
+            return expect(sum == (float)n);
+        };
+
+        "bulk add and remove"_test = [&]{
+            ecs::Scene bulk;
+            std::vector<ecs::EntityID> created;
+            benchmark("scene add_n", n, [&]{ created = bulk.add_n(n, Position{1.0f, 1.0f, 1.0f}, Velocity{1.0f, 0.0f, 0.0f}); });
+            benchmark("scene remove_range", n, [&]{ bulk.remove_range(created); });
+            return expect(created.size() == n and bulk.cpool<Position>().size() == 0 and bulk.cpool<Velocity>().size() == 0);
+        };
+
+        "tag components"_test = [&]{
+            //: tags only keep the sparse set, so the memory per entity is the one of the sparse and dense arrays
+            ecs::Scene tagged;
+            std::vector<ecs::EntityID> created;
+            benchmark("scene add_n (tag)", n, [&]{ created = tagged.add_n(n, Selected{}); });
+            const auto& pool = tagged.cpool<Selected>();
+            fresa::detail::log<"BENCHMARK", LOG_TEST | LOG_DEBUG, fmt::color::plum>("tag data {:.2f} bytes/entity", (double)sizeof(pool.data) / n);
+            benchmark("scene remove_range (tag)", n, [&]{ tagged.remove_range(created); });
+            return expect(created.size() == n and pool.size() == 0);
+        };
+
+        "observed add and remove"_test = [&]{
+            //: the pools only append the ids, and each observer gets every event in one call
+            ecs::Scene observed;
+            std::size_t added = 0, removed = 0;
+            observed.on_add<Position>([&](std::span<const ecs::EntityID> e) { added += e.size(); });
+            observed.on_remove<Position>([&](std::span<const ecs::EntityID> e) { removed += e.size(); });
+            std::vector<ecs::EntityID> created(n);
+            benchmark("scene add (observed)", n, [&]{ for (auto& e : created) e = observed.add(Position{1.0f, 1.0f, 1.0f}); });
+            benchmark("scene dispatch (adds)", n, [&]{ observed.dispatch(); });
+            benchmark("scene remove (observed)", n, [&]{ for (const auto e : created) observed.remove(e); });
+            benchmark("scene dispatch (removals)", n, [&]{ observed.dispatch(); });
+            return expect(added == n and removed == n);
+        };
+
+        "recycle entities"_test = [&]{
+            //: entities without components, so this only measures the free list
+            ecs::Scene churn;
+            std::vector<ecs::EntityID> created(n);
+            for (auto& e : created) e = churn.add();
+            benchmark("scene remove (free list)", n, [&]{ for (const auto e : created) churn.remove(e); });
+            benchmark("scene add (recycled)", n, [&]{ for (auto& e : created) e = churn.add(); });
+            return expect(churn.entities.size() == n and std::all_of(created.begin(), created.end(), [&](auto e) { return churn.valid(e) and ecs::version(e) == 1; }));
+        };
+
+        "remove with many component types"_test = [&]{
+            //: 64 other component types exist in the scene, but the removed entities only have two components
+            ecs::Scene churn;
+            [&]<std::size_t ... I>(std::index_sequence<I...>) { (churn.cpool<Filler<I>>(), ...); }(std::make_index_sequence<64>());
+            const auto created = churn.add_n(n, Position{1.0f, 1.0f, 1.0f}, Velocity{1.0f, 0.0f, 0.0f});
+            benchmark("scene remove (66 pools)", n, [&]{ for (const auto e : created) churn.remove(e); });
+            return expect(churn.cpool<Position>().size() == 0 and churn.cpool<Velocity>().size() == 0);
+        };
+
+        "pool sort"_test = [&]{
+            //: two pools with the same scattered layers, sorted with a comparator and with the radix sort
+            ecs::Scene layers;
+            for (std::size_t i = 0; i < n; i++) layers.add(Layer{ui32(i * 2654435761u) % 4096}, Position{(float)i, 0.0f, 0.0f});
+            auto& pool = layers.cpool<Layer>();
+            const auto dense = pool.dense;
+            const auto data = pool.data;
+            benchmark("pool sort (comparator)", n, [&]{ pool.sort([](const Layer& a, const Layer& b) { return a.value < b.value; }); });
+            const auto sorted = pool.data;
+            pool.clear();
+            for (std::size_t i = 0; i < n; i++) pool.add(ecs::id(dense[i], 0), Layer{data[i]});
+            benchmark("pool sort_by (radix)", n, [&]{ pool.sort_by([](const Layer& l) { return l.value; }); });
+            benchmark("pool sort_as", n, [&]{ layers.cpool<Position>().sort_as(pool); });
+            return expect(std::equal(sorted.begin(), sorted.end(), pool.data.begin(), [](auto a, auto b) { return a.value == b.value; }) and
+                          layers.cpool<Position>().dense == pool.dense);
+        };
+
+        "pool growth"_test = [&]{
+            //: the slowest single add shows the reallocation spikes of vector storage, which paged storage doesn't have
+            auto grow = [&]<typename P>(str_view name) {
+                ecs::ComponentPool<P> pool;
+                double slowest = 0.0;
+                benchmark(name, n, [&]{
+                    for (std::size_t i = 0; i < n; i++) {
+                        const auto start = time();
+                        pool.add(ecs::id(i, 0), P{1.0f, 1.0f, 1.0f});
+                        slowest = std::max(slowest, std::chrono::duration<double, std::nano>(time() - start).count());
+                    }
+                });
+                fresa::detail::log<"BENCHMARK", LOG_TEST | LOG_DEBUG, fmt::color::plum>("{}: slowest add {:.2f} us", name, slowest / 1000.0);
+                return pool.size();
+            };
+            return expect(grow.template operator()<Position>("pool add (vector)") == n and grow.template operator()<PagedPosition>("pool add (paged)") == n);
+        };
+
+        "deferred add"_test = [&]{
+            ecs::Scene deferred;
+            ecs::CommandBuffer cmd;
+            benchmark("command buffer add", n, [&]{
+                for (std::size_t i = 0; i < n; i++) cmd.add(deferred, Position{1.0f, 1.0f, 1.0f}, Velocity{1.0f, 0.0f, 0.0f});
+            });
+            benchmark("command buffer flush", n, [&]{ ecs::flush(deferred, cmd); });
+            return expect(deferred.cpool<Position>().size() == n and deferred.cpool<Velocity>().size() == n);
+        };
+
+        "snapshot"_test = [&]{
+            //: the file was just written, so this measures loading from the page cache rather than from the disk
+            const auto path = (std::filesystem::temp_directory_path() / "fresa_ecs_snapshot_benchmark.bin").string();
+            ecs::Scene world, loaded;
+            world.add_n(n, Position{1.0f, 1.0f, 1.0f}, Velocity{1.0f, 0.0f, 0.0f});
+            bool ok = true;
+            benchmark("snapshot save", n, [&]{ ok = ecs::save_snapshot<Position, Velocity>(world, path); });
+            benchmark("snapshot load", n, [&]{ ok = ok and ecs::load_snapshot<Position, Velocity>(loaded, path); });
+            fresa::detail::log<"BENCHMARK", LOG_TEST | LOG_DEBUG, fmt::color::plum>("snapshot size {:.2f} bytes/entity",
+                                                                                  (double)std::filesystem::file_size(path) / n);
+            std::filesystem::remove(path);
+            return expect(ok and loaded.cpool<Position>().size() == n and loaded.cpool<Velocity>().size() == n);
+        };
+    });
+
+    inline TestSuite ecs_contention_benchmarks("ecs_contention_benchmarks", []{
+        using namespace detail;
+
+        //: every worker thread of the job system reads all the entities of the same scene at the same time
+        constexpr std::size_t n = entity_count;
+        ecs::Scene scene;
+        const auto entities = scene.add_n(n, Position{1.0f, 1.0f, 1.0f}, Velocity{1.0f, 0.0f, 0.0f});
+
+        system::add(jobs::JobSystem());
+        const std::size_t threads = jobs::JobSystem::thread_count;
+
+        //: runs f as one job per worker thread and waits for all of them
+        auto run = [&](auto&& f) {
+            auto job = [&]() -> jobs::JobFuture<void> { f(); co_return; };
+            std::vector<std::unique_ptr<jobs::JobFuture<void>>> futures;
+            for (std::size_t t = 0; t < threads; t++) futures.emplace_back(new jobs::JobFuture<void>(job()));
+            for (auto& j : futures) jobs::schedule(*j);
+            for (auto& j : futures) while (not j->done()) std::this_thread::yield();
+        };
+
+        "scene get from every thread"_test = [&]{
+            std::atomic<std::size_t> count = 0;
+            benchmark("scene get<position, velocity> (all threads)", n * threads, [&]{
+                run([&]{
+                    float sum = 0.0f;
+                    for (const auto e : entities) sum += scene.get<Position>(e)->x + scene.get<Velocity>(e)->y;
+                    if (sum == (float)n) count++;
+                });
+            });
+            return expect(count == threads);
+        };
+
+        "locked lookup from every thread"_test = [&]{
+            //: same access pattern using a pool lookup that locks a mutex and hashes the type, for comparison
+            std::mutex mutex;
+            auto locked = [&]<typename C>(const ecs::EntityID e) {
+                std::lock_guard<std::mutex> lock(mutex);
+                return static_cast<ecs::ComponentPool<C>&>(*scene.component_pools.find(type_hash<C>())->second).get(e);
+            };
+            std::atomic<std::size_t> count = 0;
+            benchmark("locked get<position, velocity> (all threads)", n * threads, [&]{
+                run([&]{
+                    float sum = 0.0f;
+                    for (const auto e : entities) sum += locked.template operator()<Position>(e)->x + locked.template operator()<Velocity>(e)->y;
+                    if (sum == (float)n) count++;
+                });
+            });
+            return expect(count == threads);
+        };
+
+        system::manager.stop.top().f();
+        system::manager.stop.pop();
+    });
+
+    inline TestSuite ecs_view_benchmarks("ecs_view_benchmarks", []{
+        using namespace detail;
+
+        //: every entity has a position, half of them a velocity and a quarter a collider
+        constexpr std::size_t n = entity_count;
+        ecs::Scene scene;
+        for (std::size_t i = 0; i < n; i++) {
+            const auto e = scene.add(Position{1.0f, 1.0f, 1.0f});
+            if (i % 2 == 0) scene.cpool<Velocity>().add(e, Velocity{1.0f, 0.0f, 0.0f});
+            if (i % 4 == 0) scene.cpool<Collider>().add(e, Collider{0.5f});
+        }
+
+        "single component view"_test = [&]{
+            std::size_t count = 0;
+            benchmark("view<position>", n, [&]{
+                for (auto [e, p] : ecs::View<Position>(scene)) { p.x += 1.0f; count++; }
+            });
+            return expect(count == n);
+        };
+
+        "two components with scene get"_test = [&]{
+            std::size_t count = 0;
+            benchmark("view<position> + get<velocity>", n, [&]{
+                for (auto [e, p] : ecs::View<Position>(scene)) {
+                    const auto v = scene.get<Velocity>(e);
+                    if (v == nullptr) continue;
+                    p.x += v->x; count++;
+                }
+            });
+            return expect(count == (n + 1) / 2);
+        };
+
+        "two component view"_test = [&]{
+            std::size_t count = 0;
+            benchmark("view<position, velocity>", n, [&]{
+                for (auto [e, p, v] : ecs::View<Position, Velocity>(scene)) { p.x += v.x; count++; }
+            });
+            return expect(count == (n + 1) / 2);
+        };
+
+        "two component view each"_test = [&]{
+            std::size_t count = 0;
+            benchmark("view<position, velocity>::each", n, [&]{
+                ecs::View<Position, Velocity>(scene).each([&](ecs::EntityID, Position& p, Velocity& v) { p.x += v.x; count++; });
+            });
+            return expect(count == (n + 1) / 2);
+        };
+
+        "two component view parallel each"_test = [&]{
+            std::atomic<std::size_t> count = 0;
+            system::add(jobs::JobSystem());
+            benchmark("view<position, velocity>::par_each", n, [&]{
+                ecs::View<Position, Velocity>(scene).par_each([&](ecs::EntityID, Position& p, Velocity& v) { p.x += v.x; count++; }, 4096);
+            });
+            system::manager.stop.top().f();
+            system::manager.stop.pop();
+            return expect(count == (n + 1) / 2);
+        };
+
+        "changed view"_test = [&]{
+            //: a tracked scene where only one in twenty positions changes between ticks
+            ecs::Scene tracked;
+            tracked.track<Position>();
+            tracked.add_n(n, Position{1.0f, 1.0f, 1.0f}, Velocity{1.0f, 0.0f, 0.0f});
+            const auto since = tracked.advance();
+            for (std::size_t i = 0; i < n; i += 20) tracked.patch<Position>(ecs::id(i, 0))->x += 1.0f;
+            std::size_t count = 0;
+            benchmark("view<position, velocity>::changed<position>", n, [&]{
+                ecs::View<Position, Velocity>(tracked).changed<Position>(since).each([&](ecs::EntityID, Position& p, Velocity& v) { p.x += v.x; count++; });
+            });
+            return expect(count == (n + 19) / 20);
+        };
+
+        "buffered store and interpolation"_test = [&]{
+            ecs::Scene buffered;
+            buffered.buffer<Transform>();
+            buffered.add_n(n, Transform{1.0f, 1.0f, 1.0f});
+            benchmark("scene store (buffered transform)", n, [&]{ buffered.store(); });
+            ecs::View<Transform>(buffered).each([](ecs::EntityID, Transform& t) { t.x += 1.0f; });
+            float sum = 0.0f;
+            benchmark("interpolated<transform> each", n, [&]{
+                ecs::Interpolated<Transform>(buffered, 0.5f).each([&](ecs::EntityID, const Transform& t) { sum += t.x; });
+            });
+            return expect(sum == 1.5f * n);
+        };
+
+        "three component view"_test = [&]{
+            std::size_t count = 0;
+            benchmark("view<position, velocity, collider>", n, [&]{
+                ecs::View<Position, Velocity, Collider>(scene).each([&](ecs::EntityID, Position& p, Velocity& v, Collider& c) {
+                    p.x += v.x * c.radius; count++;
+                });
+            });
+            return expect(count == (n + 3) / 4);
+        };
+    });
+
+    inline TestSuite ecs_group_benchmarks("ecs_group_benchmarks", []{
+        using namespace detail;
+
+        constexpr std::size_t n = entity_count;
+        ecs::Scene scene;
+        for (std::size_t i = 0; i < n; i++) {
+            const auto e = scene.add(Position{1.0f, 1.0f, 1.0f});
+            if (i % 2 == 0) scene.cpool<Velocity>().add(e, Velocity{1.0f, 0.0f, 0.0f});
+        }
+
+        "create group"_test = [&]{
+            benchmark("group<position, velocity> creation", n, [&]{ scene.group<Position, Velocity>(); });
+            return expect(scene.group<Position, Velocity>().size() == (n + 1) / 2);
+        };
+
+        "group each"_test = [&]{
+            std::size_t count = 0;
+            benchmark("group<position, velocity>::each", n, [&]{
+                scene.group<Position, Velocity>().each([&](ecs::EntityID, Position& p, Velocity& v) { p.x += v.x; count++; });
+            });
+            return expect(count == (n + 1) / 2);
+        };
+    });
+
+    inline TestSuite ecs_query_benchmarks("ecs_query_benchmarks", []{
+        using namespace detail;
+
+        //: half of the entities are burning and the other half flammable, but only 200 are both
+        constexpr std::size_t n = entity_count;
+        constexpr std::size_t both = 200;
+        ecs::Scene scene;
+        for (std::size_t i = 0; i < n; i++) {
+            const auto e = scene.add(Position{1.0f, 1.0f, 1.0f});
+            if (i % 2 == 0 or i < both) scene.cpool<Burning>().add(e, Burning{1.0f});
+            if (i % 2 == 1 or i < both) scene.cpool<Flammable>().add(e, Flammable{1.0f});
+        }
+        std::size_t view_count = 0, query_count = 0;
+
+        "rare combination view"_test = [&]{
+            benchmark("view<burning, flammable>::each (200 matches)", both, [&]{
+                ecs::View<Burning, Flammable>(scene).each([&](ecs::EntityID, Burning& b, Flammable& f) { f.fuel -= b.heat; view_count++; });
+            });
+            return expect(view_count == both);
+        };
+
+        "rare combination query"_test = [&]{
+            benchmark("query<burning, flammable> creation", n, [&]{ scene.query<Burning, Flammable>(); });
+            benchmark("query<burning, flammable>::each (200 matches)", both, [&]{
+                scene.query<Burning, Flammable>().each([&](ecs::EntityID, Burning& b, Flammable& f) { f.fuel -= b.heat; query_count++; });
+            });
+            return expect(query_count == both);
+        };
+
+        "query upkeep"_test = [&]{
+            auto& flammable = scene.cpool<Flammable>();
+            std::vector<ecs::EntityID> entities;
+            for (std::size_t i = 0; i < flammable.size(); i++) entities.push_back(flammable.entity_at(i));
+            benchmark("pool remove and add with a query", entities.size(), [&]{
+                for (const auto e : entities) { flammable.remove(e); flammable.add(e, Flammable{1.0f}); }
+            });
+            return expect(scene.query<Burning, Flammable>().size() == both);
+        };
+    });
+
+    inline TestSuite ecs_hierarchy_benchmarks("ecs_hierarchy_benchmarks", []{
+        using namespace detail;
+
+        //: an eight way tree, with the entities created leaves first so the first propagation has to sort the whole graph
+        constexpr std::size_t n = entity_count;
+        ecs::Scene scene;
+        ecs::SceneGraph graph(scene);
+        auto local = ecs::LocalTransform{};
+        local.matrix.get<0, 3>() = 1.0f;
+        std::vector<ecs::EntityID> entities(n);
+        for (std::size_t i = n; i-- > 0;) entities[i] = scene.add(ecs::LocalTransform{local});
+        for (std::size_t i = 1; i < n; i++) graph.attach(entities[i], entities[(i - 1) / 8]);
+
+        "order and propagate"_test = [&]{
+            benchmark("scene graph order and propagate", n, [&]{ graph.propagate(); });
+            return expect(graph.levels.size() > 2 and scene.get<ecs::WorldTransform>(entities.back())->matrix.get<0, 3>() == float(graph.levels.size() - 1));
+        };
+
+        "propagate"_test = [&]{
+            benchmark("scene graph propagate (all dirty)", n, [&]{ graph.propagate(0); });
+            return expect(std::all_of(graph.dirty.begin(), graph.dirty.end(), [](ui8 d) { return d == 1; }));
+        };
+
+        "propagate dirty subtrees"_test = [&]{
+            const auto since = scene.advance();
+            for (std::size_t i = n / 2; i < n; i += 100) scene.patch<ecs::LocalTransform>(entities[i]);
+            benchmark("scene graph propagate (1% dirty)", n, [&]{ graph.propagate(since); });
+            return expect(std::count(graph.dirty.begin(), graph.dirty.end(), 1) == std::ptrdiff_t((n / 2 + 99) / 100));
+        };
+
+        "parallel propagate"_test = [&]{
+            system::add(jobs::JobSystem());
+            benchmark("scene graph par_propagate (all dirty)", n, [&]{ graph.par_propagate(0, 4096); });
+            system::manager.stop.top().f();
+            system::manager.stop.pop();
+            return expect(scene.get<ecs::WorldTransform>(entities.back())->matrix.get<0, 3>() == float(graph.levels.size() - 1));
+        };
+    });
+
+    inline TestSuite ecs_spatial_benchmarks("ecs_spatial_benchmarks", []{
+        using namespace detail;
+
+        //: agents on a square with an average of four neighbours inside the query radius
+        constexpr std::size_t n = entity_count;
+        constexpr float radius = 1.0f;
+        const float side = std::sqrt(float(n) * pi * radius * radius / 4.0f);
+        ecs::Scene scene;
+        std::vector<ecs::EntityID> agents;
+        for (std::size_t i = 0; i < n; i++) {
+            const float x = float((i * 2654435761u) % 1000003) / 1000003.0f, y = float((i * 40503u) % 65537) / 65537.0f;
+            agents.push_back(scene.add(Vec2<float>(x * side, y * side)));
+        }
+        ecs::SpatialGrid<Vec2<float>> grid(scene, radius);
+
+        "build"_test = [&]{
+            benchmark("spatial grid build", n, [&]{ grid.update(); });
+            return expect(grid.size() == n);
+        };
+
+        "pairs"_test = [&]{
+            std::size_t grid_pairs = 0;
+            benchmark("spatial grid radius query per agent", n, [&]{
+                for (auto [e, p] : ecs::View<Vec2<float>>(scene)) grid.query_radius(p, radius, [&](ecs::EntityID, const Vec2<float>&) { grid_pairs++; });
+            });
+            //: the all pairs loop is quadratic, so it only runs over the first agents and is scaled per agent for comparison
+            constexpr std::size_t m = std::min<std::size_t>(n, 4096);
+            const auto& positions = scene.cpool<Vec2<float>>().data;
+            std::size_t brute_pairs = 0, grid_subset = 0;
+            benchmark("all pairs radius check per agent (4096 agents)", m, [&]{
+                for (std::size_t i = 0; i < m; i++) for (std::size_t j = 0; j < m; j++) {
+                    const float dx = positions[i].x - positions[j].x, dy = positions[i].y - positions[j].y;
+                    if (dx * dx + dy * dy <= radius * radius) brute_pairs++;
+                }
+            });
+            for (std::size_t i = 0; i < m; i++) grid.query_radius(positions[i], radius, [&](ecs::EntityID e, const Vec2<float>&) {
+                if (scene.cpool<Vec2<float>>().position(e) < m) grid_subset++;
+            });
+            return expect(grid_pairs >= n and brute_pairs == grid_subset);
+        };
+
+        "nearest"_test = [&]{
+            std::size_t found = 0;
+            benchmark("spatial grid 8 nearest per agent", n, [&]{
+                for (auto [e, p] : ecs::View<Vec2<float>>(scene)) found += grid.nearest(p, 8).size();
+            });
+            return expect(found == n * 8);
+        };
+
+        "incremental update"_test = [&]{
+            const auto since = scene.advance();
+            for (std::size_t i = 0; i < n; i += 10) scene.patch<Vec2<float>>(agents[i])->x += 0.5f;
+            benchmark("spatial grid update (10% moved)", n, [&]{ grid.update(since); });
+            return expect(grid.size() == n);
+        };
+    });
+
+    inline TestSuite ecs_schedule_benchmarks("ecs_schedule_benchmarks", []{
+        using namespace detail;
+
+        //: eight independent systems, each one updating its own component, and a ninth one that reads all of them
+        constexpr std::size_t n = entity_count;
+        constexpr std::size_t systems = 8;
+        ecs::Scene scene;
+        [&]<std::size_t ... I>(std::index_sequence<I...>) { scene.add_n(n, Filler<I>{1.0f}...); }(std::make_index_sequence<systems>());
+        ecs::Schedule schedule;
+        [&]<std::size_t ... I>(std::index_sequence<I...>) {
+            (schedule.add<ecs::Write<Filler<I>>>("update", [&]{ ecs::View<Filler<I>>(scene).each([](ecs::EntityID, Filler<I>& f) { f.value += 1.0f; }); }), ...);
+            schedule.add<ecs::Read<Filler<I>...>>("sum", [&]{}, system::SYSTEM_PRIORITY_LAST);
+        }(std::make_index_sequence<systems>());
+
+        "sequential"_test = [&]{
+            benchmark("schedule run (8 systems, sequential)", n * systems, [&]{ for (auto& s : schedule.systems) s.f(); });
+            return expect(schedule.critical_path() == 2);
+        };
+
+        "parallel"_test = [&]{
+            system::add(jobs::JobSystem());
+            benchmark("schedule run (8 systems, job system)", n * systems, [&]{ schedule.run(); });
+            system::manager.stop.top().f();
+            system::manager.stop.pop();
+            return expect(scene.get<Filler<systems - 1>>(ecs::EntityID(0))->value == 3.0f);
+        };
+    });
+
+    inline TestSuite ecs_soa_benchmarks("ecs_soa_benchmarks", []{
+        using namespace detail;
+
+        //: integrate every position with its velocity, comparing the regular layout with the soa columns of a group
+        constexpr std::size_t n = entity_count;
+        ecs::Scene scene;
+        scene.add_n(n, Position{1.0f, 1.0f, 1.0f}, Velocity{1.0f, 0.5f, 0.25f}, SoAPosition{1.0f, 1.0f, 1.0f}, SoAVelocity{1.0f, 0.5f, 0.25f});
+        auto& aos = scene.group<Position, Velocity>();
+        auto& soa = scene.group<SoAPosition, SoAVelocity>();
+
+        "aos group integration"_test = [&]{
+            benchmark("group<position, velocity> integration", n, [&]{
+                aos.each([](ecs::EntityID, Position& p, Velocity& v) { p.x += v.x; p.y += v.y; p.z += v.z; });
+            });
+            return expect(scene.get<Position>(ecs::id(n - 1, 0))->z == 1.25f);
+        };
+
+        "soa group integration with proxies"_test = [&]{
+            benchmark("group<soa position, soa velocity> integration (proxies)", n, [&]{
+                soa.each([](ecs::EntityID, ecs::ComponentRef<SoAPosition> p, ecs::ComponentRef<SoAVelocity> v) {
+                    p.field<&SoAPosition::x>() += v.field<&SoAVelocity::x>();
+                    p.field<&SoAPosition::y>() += v.field<&SoAVelocity::y>();
+                    p.field<&SoAPosition::z>() += v.field<&SoAVelocity::z>();
+                });
+            });
+            return expect(scene.get<SoAPosition>(ecs::id(n - 1, 0))->z == 1.25f);
+        };
+
+        "soa group integration with columns"_test = [&]{
+            auto& p = scene.cpool<SoAPosition>().data;
+            auto& v = scene.cpool<SoAVelocity>().data;
+            benchmark("group<soa position, soa velocity> integration (columns)", n, [&]{
+                //: the packed range of the group is the same for both pools, so the columns can be walked as plain float arrays
+                const auto integrate = [m = soa.size()](std::span<float> a, std::span<float> b) { for (std::size_t i = 0; i < m; i++) a[i] += b[i]; };
+                integrate(p.field<&SoAPosition::x>(), v.field<&SoAVelocity::x>());
+                integrate(p.field<&SoAPosition::y>(), v.field<&SoAVelocity::y>());
+                integrate(p.field<&SoAPosition::z>(), v.field<&SoAVelocity::z>());
+            });
+            return expect(scene.get<SoAPosition>(ecs::id(n - 1, 0))->z == 1.5f);
+        };
+    });
+
+    inline TestSuite ecs_archetype_benchmarks("ecs_archetype_benchmarks", []{
+        using namespace detail;
+
+        //: same distribution as the view benchmarks, but the entities are split in three archetypes
+        constexpr std::size_t n = entity_count;
+        ecs::ArchetypeScene scene;
+        for (std::size_t i = 0; i < n; i++) {
+            if (i % 4 == 0) scene.add(Position{1.0f, 1.0f, 1.0f}, Velocity{1.0f, 0.0f, 0.0f}, Collider{0.5f});
+            else if (i % 2 == 0) scene.add(Position{1.0f, 1.0f, 1.0f}, Velocity{1.0f, 0.0f, 0.0f});
+            else scene.add(Position{1.0f, 1.0f, 1.0f});
+        }
+
+        "two component archetype each"_test = [&]{
+            std::size_t count = 0;
+            benchmark("archetype each<position, velocity>", n, [&]{
+                scene.each<Position, Velocity>([&](ecs::EntityID, Position& p, Velocity& v) { p.x += v.x; count++; });
+            });
+            return expect(count == (n + 1) / 2);
+        };
+
+        "three component archetype each"_test = [&]{
+            std::size_t count = 0;
+            benchmark("archetype each<position, velocity, collider>", n, [&]{
+                scene.each<Position, Velocity, Collider>([&](ecs::EntityID, Position& p, Velocity& v, Collider& c) {
+                    p.x += v.x * c.radius; count++;
+                });
+            });
+            return expect(count == (n + 3) / 4);
+        };
+    });
+
+    inline TestSuite ecs_scaling_benchmarks("ecs_scaling_benchmarks", []{
+        using namespace detail;
+
+        //: the same operations at several scales and with each storage of the position component, to catch regressions in the pools
+        //      and compare the storages. sizes past max_entities are skipped, so the larger ones need ecs_benchmarks_config.h
+        constexpr std::array<std::size_t, 3> sizes = {1000, 100000, 1000000};
+
+        //: every entity has a position and half of them a velocity
+        auto run = [&]<typename P>(str_view storage, const std::size_t n) {
+            ecs::Scene scene;
+            std::vector<ecs::EntityID> entities(n);
+            benchmark(fmt::format("scene add ({})", storage), n, [&]{
+                for (std::size_t i = 0; i < n; i++)
+                    entities[i] = i % 2 == 0 ? scene.add(P{1.0f, 1.0f, 1.0f}, Velocity{1.0f, 0.0f, 0.0f}) : scene.add(P{1.0f, 1.0f, 1.0f});
+            });
+
+            const auto entity_bytes = scene.entities.capacity() * sizeof(ecs::EntityID) + scene.signatures.capacity() * sizeof(ecs::detail::Signature);
+            fresa::detail::log<"BENCHMARK", LOG_TEST | LOG_DEBUG, fmt::color::plum>("memory ({}): entities {:.2f} bytes/entity, position {:.2f} bytes/entity, velocity {:.2f} bytes/entity ({} entities)",
+                storage, (double)entity_bytes / n, scene.cpool<P>().memory().bytes_per_entity(), (double)scene.cpool<Velocity>().memory().bytes() / n, n);
+
+            //: visit the entities in a scattered order using a stride coprime with the number of entities
+            std::size_t stride = 7919;
+            while (std::gcd(stride, n) != 1) stride++;
+            float sum = 0.0f;
+            benchmark(fmt::format("scene get ({})", storage), n, [&]{
+                for (std::size_t i = 0, j = 0; i < n; i++, j = (j + stride) % n) sum += scene.get<P>(entities[j])->x;
+            });
+
+            benchmark(fmt::format("view<position> ({})", storage), n, [&]{
+                ecs::View<P>(scene).each([&](ecs::EntityID, auto&& p) { sum += P(p).x; });
+            });
+            benchmark(fmt::format("view<position, velocity> ({})", storage), n, [&]{
+                ecs::View<P, Velocity>(scene).each([&](ecs::EntityID, auto&& p, Velocity& v) { sum += P(p).x + v.x; });
+            });
+
+            ecs::ComponentPool<P> pool;
+            benchmark(fmt::format("pool add range ({})", storage), n, [&]{ pool.add(entities, P{1.0f, 1.0f, 1.0f}); });
+
+            benchmark(fmt::format("scene remove ({})", storage), n, [&]{ for (const auto e : entities) scene.remove(e); });
+
+            //: the pools keep the memory of the peak until they are compacted
+            const auto peak = scene.memory().bytes();
+            benchmark(fmt::format("scene compact ({})", storage), n, [&]{ scene.compact(); });
+            fresa::detail::log<"BENCHMARK", LOG_TEST | LOG_DEBUG, fmt::color::plum>("compact ({}): {} bytes after removing every entity, {} after compacting",
+                                                                                  storage, peak, scene.memory().bytes());
+            return sum == (float)(2 * n + 2 * ((n + 1) / 2)) and pool.size() == n and scene.cpool<P>().size() == 0 and scene.cpool<Velocity>().size() == 0;
+        };
+
+        "scaling"_test = [&]{
+            bool ok = true;
+            for (const auto n : sizes) {
+                if (n > ecs::max_entities) {
+                    fresa::detail::log<"BENCHMARK", LOG_TEST | LOG_DEBUG, fmt::color::plum>("skipping {} entities, the scene holds up to {}", n, ecs::max_entities);
+                    continue;
+                }
+                ok = ok and run.template operator()<Position>("vector", n);
+                ok = ok and run.template operator()<SoAPosition>("soa", n);
+                ok = ok and run.template operator()<PagedPosition>("paged", n);
+            }
+            return expect(ok);
+        };
+
+        "pool creation"_test = [&]{
+            //: first use of 64 component types in a new scene, each one creates its pool under the lock
+            constexpr std::size_t pools = 64;
+            ecs::Scene scene;
+            const auto start = time();
+            [&]<std::size_t ... I>(std::index_sequence<I...>) { (scene.cpool<Filler<I>>(), ...); }(std::make_index_sequence<pools>());
+            const auto ns = std::chrono::duration<double, std::nano>(time() - start).count();
+            fresa::detail::log<"BENCHMARK", LOG_TEST | LOG_DEBUG, fmt::color::plum>("scene pool creation: {:.2f} ns/pool ({} pools)", ns / pools, pools);
+            return expect(scene.component_pools.size() == pools);
+        };
+    });
+}
+
+#endif
@@ -0,0 +1,25 @@
+//* ecs_benchmarks_config
+//      engine configuration for the ecs benchmarks, with wider entity indices so every requested size runs (up to 1M entities)
+//      select it when building the benchmarks with FRESA_CONFIG_FILE="ecs_benchmarks_config.h", this directory must be in the include path
+#pragma once
+#include "fresa_config.h"
+
+namespace fresa
+{
+    constexpr inline struct _EngineConfig : EngineConfig {
+        constexpr str_view run_tests() const override {
+            return "ecs_entity_benchmarks,ecs_contention_benchmarks,ecs_view_benchmarks,ecs_group_benchmarks,ecs_query_benchmarks,ecs_hierarchy_benchmarks,"
+                   "ecs_spatial_benchmarks,ecs_schedule_benchmarks,ecs_soa_benchmarks,ecs_archetype_benchmarks,ecs_scaling_benchmarks";
+        }
+        constexpr ui32 log_level() const override { return 0b0111111; }
+        //: 24 index bits hold 16M entities, and the id still fits in 32 bits
+        constexpr ui32 ecs_index_bits() const override { return 24; }
+        constexpr ui32 ecs_version_bits() const override { return 8; }
+    } engine_config;
+
+    inline RunConfig config{};
+
+    #ifdef FRESA_DEBUG
+    inline DebugConfig debug_config{};
+    #endif
+}
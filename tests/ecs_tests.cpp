@@ -3,9 +3,76 @@
 
 #include "unit_test.h"
 #include "ecs.h"
+#include "ecs_archetype.h"
+#include "ecs_commands.h"
+#include "ecs_snapshot.h"
+#include "ecs_hierarchy.h"
+#include "ecs_spatial.h"
+#include "ecs_schedule.h"
+#include "system.h"
+#include <filesystem>
+#include <memory_resource>
 
 #include "_debug_cpool.h" //! ONLY FOR TESTING
 
+namespace test::detail
+{
+    struct Particle { float x, y; int id; };
+    struct Stable { int value; };
+    struct Pooled { int value; };
+    struct PagedPooled { int value; };
+    struct Huge { float value; };
+    struct Agent { fresa::Vec2<float> position; int id; };
+    struct Frozen {};
+
+    //: systems registered in the engine schedule, with and without access declarations
+    struct MovementSystem {
+        static inline int updates = 0;
+        static void init() {}
+        static void update() { updates++; }
+        static void stop() {}
+    };
+    struct SerialSystem {
+        static inline int updates = 0;
+        static void init() {}
+        static void update() { updates++; }
+        static void stop() {}
+    };
+
+    //: memory resource that counts the bytes it has allocated
+    struct CountingResource : std::pmr::memory_resource {
+        std::size_t allocated = 0;
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+            allocated += bytes;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+        void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override { std::pmr::new_delete_resource()->deallocate(p, bytes, alignment); }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+    };
+    inline CountingResource counting_resource;
+}
+template <> struct fresa::ecs::SoA<test::detail::Particle> {
+    static constexpr auto fields = std::tuple{&test::detail::Particle::x, &test::detail::Particle::y, &test::detail::Particle::id};
+};
+template <> struct fresa::ecs::Interpolate<test::detail::Particle> {
+    static test::detail::Particle lerp(const test::detail::Particle& a, const test::detail::Particle& b, float t) {
+        return {fresa::interpolate(a.x, b.x, t), fresa::interpolate(a.y, b.y, t), t < 0.5f ? a.id : b.id};
+    }
+};
+template <> struct fresa::ecs::Paged<test::detail::Stable> { static constexpr std::size_t page_size = 64; };
+template <> struct fresa::ecs::Allocator<test::detail::Pooled> {
+    using type = std::pmr::polymorphic_allocator<test::detail::Pooled>;
+    static type get() { return &test::detail::counting_resource; }
+};
+template <> struct fresa::ecs::Paged<test::detail::PagedPooled> { static constexpr std::size_t page_size = 16; };
+template <> struct fresa::ecs::Allocator<test::detail::PagedPooled> {
+    using type = std::pmr::polymorphic_allocator<test::detail::PagedPooled>;
+    static type get() { return &test::detail::counting_resource; }
+};
+template <> struct fresa::ecs::Paged<test::detail::Huge> { static constexpr std::size_t page_size = (1 << 21) / sizeof(float); };
+template <> struct fresa::ecs::Allocator<test::detail::Huge> { using type = fresa::ecs::HugePageAllocator<test::detail::Huge>; };
+template <> struct fresa::ecs::Spatial<test::detail::Agent> { static constexpr auto position = &test::detail::Agent::position; };
+
 namespace test
 {
     using namespace fresa;
@@ -57,8 +124,8 @@ namespace test
         "add entity"_test = [&]{
             auto e1 = scene.add();
             auto e2 = scene.add();
-            return expect(e1 == ecs::id(0, 0) and e2 == ecs::id(1, 0) and
-                          scene.free_entities.size() == 1 and scene.free_entities.front() == ecs::id(2, 0));
+            return expect(e1 == ecs::id(0, 0) and e2 == ecs::id(1, 0) and scene.valid(e2) and
+                          scene.entities.size() == 2 and scene.free_list == ecs::max_entities);
         };
 
         "component types"_test = [&]{
@@ -76,7 +143,130 @@ namespace test
         "remove entity"_test = [&]{
             auto e = scene.add(int{16});
             scene.remove(e);
-            return expect(scene.free_entities.size() == 2 and scene.free_entities.front() == e and scene.get<int>(e) == nullptr);
+            const bool removed = not scene.valid(e) and scene.free_list == ecs::index(e).value and scene.get<int>(e) == nullptr;
+            scene.remove(e);
+            const auto recycled = scene.add();
+            return expect(removed and recycled == ecs::id(ecs::index(e), 1) and scene.valid(recycled) and scene.free_list == ecs::max_entities);
+        };
+    });
+
+    inline TestSuite scene_signature_tests("ecs_scene_signature", []{
+        ecs::Scene scene;
+        const auto e1 = scene.add(int{1}, float{1.0f});
+        const auto e2 = scene.add(int{2}, char{'a'});
+
+        "signature"_test = [&]{
+            const auto s = scene.signature(e1);
+            return expect(s.test(scene.cpool<int>().component) and s.test(scene.cpool<float>().component) and
+                          not s.test(scene.cpool<char>().component) and scene.indexed_pools.at(scene.cpool<char>().component).load() == &scene.cpool<char>());
+        };
+
+        "has components"_test = [&]{
+            return expect(scene.has<int, float>(e1) and not scene.has<int, float>(e2) and scene.has<char>(e2) and
+                          not scene.has<int>(ecs::id(0, 1)) and not scene.has<int>(ecs::id(100, 0)));
+        };
+
+        "remove updates signatures"_test = [&]{
+            scene.cpool<float>().remove(e1);
+            const bool removed_one = not scene.signature(e1).test(scene.cpool<float>().component) and scene.has<int>(e1);
+            scene.remove(e2);
+            return expect(removed_one and scene.signature(e2).bits == ecs::detail::Signature{}.bits and scene.get<int>(e2) == nullptr and
+                          scene.get<char>(e2) == nullptr and scene.cpool<int>().size() == 1);
+        };
+
+        "view uses signatures"_test = [&]{
+            scene.add_n(10, int{3}, float{0.5f});
+            scene.cpool<float>().remove(ecs::id(5, 0));
+            int sum = 0;
+            for (auto [e, f, i] : ecs::View<float, int>(scene)) sum += i;
+            return expect(sum == 27);
+        };
+    });
+
+    inline TestSuite pool_sort_tests("ecs_pool_sort", []{
+        ecs::Scene scene;
+        const std::array<int, 8> values = {5, -3, 12, 0, 7, -3, 300, 1};
+        for (const auto v : values) scene.add(int{v}, float{(float)v});
+        scene.remove(ecs::id(2, 0));
+        scene.cpool<float>().remove(ecs::id(3, 0));
+
+        //: checks that the ids still point to their values after sorting
+        auto consistent = [&]{
+            bool same = true;
+            for (auto [e, i, f] : ecs::View<int, float>(scene)) same = same and i == values.at(ecs::index(e).value) and f == (float)i;
+            for (std::size_t i = 0; i < scene.cpool<int>().size(); i++)
+                same = same and scene.cpool<int>().data[i] == values.at(scene.cpool<int>().dense[i].value);
+            return same;
+        };
+
+        "sort with comparator"_test = [&]{
+            scene.cpool<int>().sort([](const int& a, const int& b) { return a > b; });
+            const auto& data = scene.cpool<int>().data;
+            return expect(std::is_sorted(data.begin(), data.end(), std::greater<int>()) and data.size() == 7 and consistent());
+        };
+
+        "sort by integral key"_test = [&]{
+            scene.cpool<int>().sort_by([](const int& i) { return i; });
+            const auto& data = scene.cpool<int>().data;
+            const auto& dense = scene.cpool<int>().dense;
+            return expect(std::is_sorted(data.begin(), data.end()) and data.front() == -3 and data.back() == 300 and
+                          dense.at(0).value == 1 and dense.at(1).value == 5 and consistent());
+        };
+
+        "sort as another pool"_test = [&]{
+            scene.cpool<float>().sort_as(scene.cpool<int>());
+            const auto& ints = scene.cpool<int>();
+            const auto& floats = scene.cpool<float>();
+            bool same = floats.size() == 6;
+            for (std::size_t i = 0, j = 0; i < ints.size(); i++) {
+                if (not floats.contains(ints.entity_at(i))) continue;
+                same = same and floats.dense.at(j++) == ints.dense.at(i);
+            }
+            return expect(same and consistent());
+        };
+
+        "sort tracked pool"_test = [&]{
+            scene.track<int>();
+            const auto t = scene.advance();
+            *scene.patch<int>(ecs::id(6, 0)) += 0;
+            scene.cpool<int>().sort([](const int& a, const int& b) { return a > b; });
+            int changed = 0;
+            for (auto [e, i, f] : ecs::View<int, float>(scene).changed<int>(t)) changed += i;
+            return expect(changed == 300 and consistent());
+        };
+    });
+
+    inline TestSuite scene_bulk_tests("ecs_scene_bulk", []{
+        ecs::Scene scene;
+        scene.add(int{-1});
+
+        "add multiple entities"_test = [&]{
+            auto entities = scene.add_n(100, int{3}, float{0.5f});
+            return expect(entities.size() == 100 and entities.front() == ecs::id(1, 0) and entities.back() == ecs::id(100, 0) and
+                          scene.entities.size() == 101 and scene.cpool<int>().size() == 101 and
+                          scene.cpool<float>().size() == 100 and *scene.get<int>(entities.at(50)) == 3 and *scene.get<float>(entities.at(99)) == 0.5f);
+        };
+
+        "remove multiple entities"_test = [&]{
+            std::vector<ecs::EntityID> entities;
+            for (int i = 1; i <= 100; i += 2) entities.push_back(ecs::id(i, 0));
+            scene.remove_range(entities);
+            int sum = 0;
+            for (auto [e, i, f] : ecs::View<int, float>(scene)) sum += i;
+            return expect(sum == 150 and scene.cpool<int>().size() == 51 and scene.get<int>(ecs::id(1, 0)) == nullptr and
+                          *scene.get<int>(ecs::id(2, 0)) == 3 and scene.add() == ecs::id(99, 1));
+        };
+
+        "small batches"_test = [&]{
+            //: many small batches keep the geometric growth of the pool instead of reallocating it on every call
+            ecs::Scene batches;
+            std::size_t reallocations = 0;
+            for (int i = 0; i < 1000; i++) {
+                const auto capacity = batches.cpool<int>().dense.capacity();
+                batches.add_n(2, int{i});
+                if (batches.cpool<int>().dense.capacity() != capacity) reallocations++;
+            }
+            return expect(batches.cpool<int>().size() == 2000 and reallocations < 16);
         };
     });
 
@@ -95,6 +285,993 @@ namespace test
             ecs::View<int> view(scene);
             return expect(true);
          };
+
+        "single component view"_test = [&]{
+            int sum = 0;
+            for (auto [e, i] : ecs::View<int>(scene)) sum += i;
+            return expect(sum == 1 + 3 + 7);
+        };
+
+        "multiple component view"_test = [&]{
+            auto e1 = scene.add(int{10}, float{0.5f});
+            auto e2 = scene.add(float{1.5f});
+            auto e3 = scene.add(int{20}, float{2.5f});
+            std::vector<ecs::EntityID> entities;
+            for (auto [e, i, f] : ecs::View<int, float>(scene)) entities.push_back(e);
+            return expect(entities.size() == 2 and entities.at(0) == e1 and entities.at(1) == e3);
+        };
+
+        "view each"_test = [&]{
+            ecs::View<float, int>(scene).each([](ecs::EntityID, float& f, int& i) { i += (int)f; });
+            int sum = 0;
+            for (auto [e, i] : ecs::View<int>(scene)) sum += i;
+            return expect(sum == 1 + 3 + 7 + 10 + 22);
+        };
+
+        "view parallel each"_test = [&]{
+            ecs::Scene large;
+            for (int i = 0; i < 10000; i++) {
+                const auto e = large.add(int{i});
+                if (i % 3 == 0) large.cpool<float>().add(e, float{1.0f});
+            }
+            system::add(jobs::JobSystem());
+            ecs::View<int, float>(large).par_each([](ecs::EntityID, int& i, float& f) { f += (float)i; }, 256);
+            system::manager.stop.top().f();
+            system::manager.stop.pop();
+
+            int count = 0;
+            for (auto [e, i, f] : ecs::View<int, float>(large))
+                if (f == (float)i + 1.0f) count++;
+            return expect(count == 3334);
+        };
+
+        "stale versions"_test = [&]{
+            //: the float belongs to a newer version of the same index, so it must not be paired with the int of the live entity
+            ecs::Scene stale;
+            const auto e = stale.add(int{1});
+            stale.cpool<float>().add(ecs::id(ecs::index(e), ecs::Version(ecs::version(e).value + 1)), float{2.0f});
+            int count = 0;
+            for (auto [entity, i, f] : ecs::View<int, float>(stale)) count++;
+            for (auto [entity, f, i] : ecs::View<float, int>(stale)) count++;
+            ecs::View<int, float>(stale).each([&](ecs::EntityID, int&, float&) { count++; });
+            return expect(count == 0 and stale.signature(e).test(ecs::detail::component_id<float>()));
+        };
+    });
+
+    inline TestSuite command_buffer_tests("ecs_command_buffer", []{
+        ecs::Scene scene;
+        const auto e1 = scene.add(int{1});
+        const auto e2 = scene.add(int{2}, float{2.0f});
+
+        "record commands"_test = [&]{
+            ecs::CommandBuffer cmd;
+            const auto e3 = cmd.add(scene, int{3}, str{"a long string that doesn't fit in the small buffer"});
+            cmd.emplace(e1, float{1.0f});
+            cmd.erase<float>(e2);
+            cmd.remove(e3);
+            const auto e4 = cmd.add(scene, str{"deferred"});
+            const bool pending = scene.get<int>(e3) == nullptr and scene.cpool<float>().size() == 1;
+            ecs::flush(scene, cmd);
+            return expect(pending and e3 == ecs::id(2, 0) and e4 == ecs::id(3, 0) and cmd.empty() and
+                          *scene.get<float>(e1) == 1.0f and scene.get<float>(e2) == nullptr and scene.get<int>(e3) == nullptr and
+                          scene.get<str>(e3) == nullptr and *scene.get<str>(e4) == "deferred" and scene.add() == ecs::id(2, 1));
+        };
+
+        "replace component"_test = [&]{
+            ecs::CommandBuffer cmd;
+            cmd.emplace(e1, int{10});
+            cmd.emplace(e1, int{20});
+            ecs::flush(scene, cmd);
+            return expect(*scene.get<int>(e1) == 20 and scene.cpool<int>().size() == 2);
+        };
+
+        "discard commands"_test = [&]{
+            auto value = std::make_shared<int>(5);
+            {
+                ecs::CommandBuffer cmd;
+                for (int i = 0; i < 1000; i++) cmd.emplace(e2, value);
+            }
+            return expect(value.use_count() == 1 and scene.get<std::shared_ptr<int>>(e2) == nullptr);
+        };
+
+        "dead entities"_test = [&]{
+            //: the entity is removed from the scene before the flush, so its component is discarded instead of added to a dead id
+            auto value = std::make_shared<int>(5);
+            ecs::CommandBuffer cmd;
+            const auto e = scene.add(int{5});
+            cmd.emplace(e, value);
+            cmd.erase<int>(e);
+            scene.remove(e);
+            ecs::flush(scene, cmd);
+            return expect(value.use_count() == 1 and not scene.cpool<std::shared_ptr<int>>().contains(e) and scene.signature(e).none());
+        };
+
+        "move assignment"_test = [&]{
+            auto value = std::make_shared<int>(5);
+            ecs::CommandBuffer cmd, other;
+            cmd.emplace(e2, value);
+            other.emplace(e1, float{3.0f});
+            cmd = std::move(other);
+            const bool discarded = value.use_count() == 1 and cmd.size() == 1 and other.empty();
+            ecs::flush(scene, cmd);
+            return expect(discarded and *scene.get<float>(e1) == 3.0f);
+        };
+
+        "record from jobs"_test = [&]{
+            ecs::Scene large;
+            ecs::CommandBuffers commands;
+            auto spawn = [&](int first) -> jobs::JobFuture<void> {
+                auto& cmd = commands.local();
+                for (int i = first; i < first + 100; i++) cmd.add(large, int{i});
+                co_return;
+            };
+
+            system::add(jobs::JobSystem());
+            std::vector<std::unique_ptr<jobs::JobFuture<void>>> futures;
+            for (int i = 0; i < 10; i++) futures.emplace_back(new jobs::JobFuture<void>(spawn(i * 100)));
+            for (auto& f : futures) jobs::schedule(*f);
+            for (auto& f : futures) while (not f->done()) std::this_thread::yield();
+            system::manager.stop.top().f();
+            system::manager.stop.pop();
+
+            const auto recorded = commands.size();
+            commands.flush(large);
+            long sum = 0;
+            for (auto [e, i] : ecs::View<int>(large)) sum += i;
+            return expect(recorded == 1000 and commands.size() == 0 and large.cpool<int>().size() == 1000 and sum == 499500 and
+                          large.add() == ecs::id(1000, 0));
+        };
+    });
+
+    inline TestSuite schedule_tests("ecs_schedule", []{
+        using detail::Particle;
+        using detail::Stable;
+
+        //: each system records when it starts and ends, counted in a shared clock
+        std::atomic<int> clock = 0;
+        std::map<str, std::pair<int, int>> spans;
+        std::mutex mutex;
+        const auto record = [&](str name) {
+            return [&, name]{
+                const int start = clock++;
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                std::lock_guard lock(mutex);
+                spans[name] = {start, clock++};
+            };
+        };
+        const auto before = [&](str a, str b) { return spans[a].second < spans[b].first; };
+
+        ecs::Schedule schedule;
+        schedule.add<ecs::Read<float>, ecs::Write<int>>("integrate", record("integrate"));
+        schedule.add<ecs::Read<int>>("render", record("render"), system::SYSTEM_PRIORITY_LAST);
+        schedule.add<ecs::Read<int>, ecs::Read<float>>("audio", record("audio"));
+        schedule.add<ecs::Write<float>>("input", record("input"), system::SYSTEM_PRIORITY_FIRST);
+        schedule.add<ecs::Write<Particle>>("particles", record("particles"));
+        schedule.add<ecs::Read<Stable>, ecs::Write<Stable>>("stable", record("stable"));
+
+        "dependency graph"_test = [&]{
+            schedule.build();
+            const auto find = [&](str_view name) { return std::find_if(schedule.systems.begin(), schedule.systems.end(), [&](auto& s) { return s.name == name; }); };
+            const auto successors = [&](str_view name) {
+                std::vector<str> names;
+                for (auto i : find(name)->successors) names.push_back(schedule.systems[i].name);
+                std::sort(names.begin(), names.end());
+                return names;
+            };
+            //: audio and render only read int, so they don't depend on each other, and render doesn't wait for input through integrate
+            return expect(schedule.systems.front().name == "input" and schedule.systems.back().name == "render" and
+                          successors("input") == std::vector<str>{"integrate"} and successors("integrate") == std::vector<str>{"audio", "render"} and
+                          successors("audio").empty() and find("render")->dependencies == 1 and find("stable")->access.reads.empty() and
+                          find("particles")->dependencies == 0 and schedule.critical_path() == 3);
+        };
+
+        "serial run"_test = [&]{
+            schedule.run();
+            return expect(spans.size() == 6 and before("input", "integrate") and before("integrate", "audio") and before("integrate", "render") and
+                          before("input", "audio") and before("audio", "render"));
+        };
+
+        "parallel run"_test = [&]{
+            spans.clear();
+            system::add(jobs::JobSystem());
+            schedule.run();
+            schedule.run();
+            system::manager.stop.top().f();
+            system::manager.stop.pop();
+            return expect(spans.size() == 6 and before("input", "integrate") and before("integrate", "audio") and before("integrate", "render"));
+        };
+
+        "exclusive"_test = [&]{
+            schedule.add<ecs::Exclusive>("spawn", record("spawn"));
+            schedule.remove("particles");
+            spans.clear();
+            system::add(jobs::JobSystem());
+            schedule.run();
+            system::manager.stop.top().f();
+            system::manager.stop.pop();
+            bool alone = true;
+            for (const auto& [name, span] : spans) if (name != "spawn") alone = alone and (before(name, "spawn") or before("spawn", name));
+            return expect(spans.size() == 6 and alone and not spans.contains("particles") and schedule.critical_path() == 5);
+        };
+
+        "engine schedule"_test = [&]{
+            using detail::MovementSystem, detail::SerialSystem;
+            ecs::add_system<ecs::Read<float>, ecs::Write<int>>(MovementSystem{});
+            system::add(SerialSystem{}, system::SYSTEM_PRIORITY_FIRST);
+            ecs::update();
+            ecs::update();
+            const auto& systems = ecs::schedule.systems;
+            const bool ok = MovementSystem::updates == 2 and SerialSystem::updates == 2 and system::manager.update.empty() and systems.size() == 2 and
+                            systems.front().name == type_name<SerialSystem>() and systems.front().access.exclusive and
+                            systems.back().access.writes == std::vector<ui32>{ecs::detail::component_id<int>()};
+            for (int i = 0; i < 2; i++) { system::manager.stop.top().f(); system::manager.stop.pop(); }
+            ecs::schedule = ecs::Schedule{};
+            return expect(ok);
+        };
+    });
+
+    inline TestSuite change_tracking_tests("ecs_change_tracking", []{
+        ecs::Scene scene;
+        scene.track<int>();
+        for (int i = 0; i < 10; i++) scene.add(int{i}, float{(float)i});
+        const auto start = scene.tick;
+
+        //: sum of the ints visited by a view filtered with f
+        auto sum = [&](auto&& view) { int s = 0; for (auto [e, i, f] : view) s += i; return s; };
+
+        "added since"_test = [&]{
+            const auto t = scene.advance();
+            scene.add(int{100}, float{0.0f});
+            scene.cpool<int>().add(ecs::id(11, 0), int{200});
+            return expect(sum(ecs::View<int, float>(scene).added<int>(t)) == 100 and sum(ecs::View<int, float>(scene).added<int>(start)) == 145 and
+                          scene.cpool<int>().added_ticks.size() == scene.cpool<int>().size());
+        };
+
+        "changed since"_test = [&]{
+            const auto t = scene.advance();
+            *scene.patch<int>(ecs::id(3, 0)) += 10;
+            scene.cpool<int>().touch(ecs::id(7, 0));
+            for (auto [e, i, f] : ecs::View<int, float>(scene)) i += 1;
+            int count = 0;
+            ecs::View<int, float>(scene).changed<int>(t).each([&](ecs::EntityID, int&, float&) { count++; });
+            return expect(count == 2 and sum(ecs::View<int, float>(scene).changed<int>(t)) == 14 + 8);
+        };
+
+        "removed since"_test = [&]{
+            const auto t = scene.advance();
+            scene.remove(ecs::id(3, 0));
+            scene.cpool<int>().remove(ecs::id(5, 0));
+            const auto removed = scene.cpool<int>().removed_since(t);
+            const bool tracked = sum(ecs::View<int, float>(scene).changed<int>(t - 1)) == 8;
+            scene.cpool<int>().trim(t + 1);
+            return expect(tracked and removed.size() == 2 and removed.at(0) == ecs::id(3, 0) and removed.at(1) == ecs::id(5, 0) and
+                          scene.cpool<int>().removed_since(t).empty() and scene.cpool<float>().removed_ticks.empty());
+        };
+    });
+
+    inline TestSuite observer_tests("ecs_observers", []{
+        ecs::Scene scene;
+        for (int i = 0; i < 10; i++) scene.add(int{i});
+
+        //: every batch delivered to each observer, the calls are counted to check that each kind is delivered once
+        std::vector<ecs::EntityID> added, removed, updated;
+        int calls = 0;
+        scene.on_add<int>([&](std::span<const ecs::EntityID> e) { added.assign(e.begin(), e.end()); calls++; });
+        scene.on_remove<int>([&](std::span<const ecs::EntityID> e) { removed.assign(e.begin(), e.end()); calls++; });
+        scene.on_update<int>([&](std::span<const ecs::EntityID> e) { updated.assign(e.begin(), e.end()); calls++; });
+        auto dispatch = [&]{ added.clear(); removed.clear(); updated.clear(); calls = 0; scene.dispatch(); };
+
+        "batched events"_test = [&]{
+            const auto a = scene.add(int{10});
+            const auto b = scene.add_n(2, int{11});
+            scene.remove(ecs::id(2, 0));
+            *scene.patch<int>(ecs::id(4, 0)) += 1;
+            scene.cpool<int>().touch(ecs::id(5, 0));
+            const bool deferred = calls == 0 and scene.cpool<int>().events[ecs::detail::ComponentPoolBase::Added].size() == 3;
+            dispatch();
+            return expect(deferred and calls == 3 and added == std::vector{a, b.at(0), b.at(1)} and removed == std::vector{ecs::id(2, 0)} and
+                          updated == std::vector{ecs::id(4, 0), ecs::id(5, 0)});
+        };
+
+        "net changes"_test = [&]{
+            //: repeated updates are reported once, updates of added entities and removals of entities added again are dropped
+            for (int i = 0; i < 3; i++) scene.cpool<int>().touch(ecs::id(6, 0));
+            scene.cpool<int>().remove(ecs::id(7, 0));
+            scene.cpool<int>().add(ecs::id(7, 0), int{7});
+            scene.cpool<int>().touch(ecs::id(7, 0));
+            scene.cpool<int>().touch(ecs::id(8, 0));
+            scene.remove(ecs::id(8, 0));
+            dispatch();
+            const bool net = calls == 3 and added == std::vector{ecs::id(7, 0)} and removed == std::vector{ecs::id(8, 0)} and
+                             updated == std::vector{ecs::id(6, 0)};
+            dispatch();
+            return expect(net and calls == 0);
+        };
+
+        "events from observers"_test = [&]{
+            //: removing inside an observer is delivered on the next dispatch
+            scene.on_add<float>([&](std::span<const ecs::EntityID> e) { for (auto entity : e) scene.cpool<int>().remove(entity); });
+            const auto e = scene.add(int{20}, float{20.0f});
+            dispatch();
+            const bool first = added == std::vector{e} and removed.empty();
+            dispatch();
+            return expect(first and removed == std::vector{e} and scene.observed_pools.size() == 2);
+        };
+
+        "clear and stop observing"_test = [&]{
+            const auto n = scene.cpool<int>().size();
+            scene.cpool<int>().clear();
+            dispatch();
+            const bool cleared = removed.size() == n;
+            scene.clear_observers<int>();
+            scene.add(int{30});
+            dispatch();
+            return expect(cleared and calls == 0 and scene.cpool<int>().events[ecs::detail::ComponentPoolBase::Added].empty() and
+                          scene.observed_pools.size() == 1);
+        };
+    });
+
+    inline TestSuite interpolation_tests("ecs_interpolation", []{
+        using detail::Particle;
+        ecs::Scene scene;
+        scene.buffer<float>();
+        scene.buffer<Particle>();
+        for (int i = 0; i < 10; i++) scene.add(float(i), Particle{(float)i, 0.0f, i});
+        scene.store();
+        for (auto [e, f, p] : ecs::View<float, Particle>(scene)) { f += 10.0f; p.field<&Particle::y>() = 2.0f; }
+
+        "interpolated"_test = [&]{
+            const auto e = ecs::id(3, 0);
+            const auto p = scene.interpolated<Particle>(e, 0.5f);
+            return expect(scene.interpolated<float>(e, 0.0f) == 3.0f and scene.interpolated<float>(e, 1.0f) == 13.0f and
+                          scene.interpolated<float>(e, 0.5f) == 8.0f and p.x == 3.0f and p.y == 1.0f and p.id == 3);
+        };
+
+        "structural changes"_test = [&]{
+            scene.remove(ecs::id(0, 0));
+            const auto added = scene.add(float{100.0f});
+            bool ok = scene.interpolated<float>(added, 0.25f) == 100.0f;
+            for (int i = 1; i < 10; i++) ok = ok and scene.interpolated<float>(ecs::id(i, 0), 0.5f) == i + 5.0f;
+            return expect(ok);
+        };
+
+        "interpolated view"_test = [&]{
+            float sum = 0.0f, each = 0.0f;
+            for (auto [e, f] : ecs::Interpolated<float>(scene, 0.5f)) sum += f;
+            ecs::Interpolated<float>(scene, 0.5f).each([&](ecs::EntityID, float f) { each += f; });
+            scene.store();
+            const bool stored = scene.interpolated<float>(ecs::id(5, 0), 0.0f) == 15.0f;
+            return expect(sum == 45.0f + 45.0f + 100.0f and each == sum and stored);
+        };
+
+        "store every step"_test = [&]{
+            //: the store system runs first on every step, so the previous state is always the one of the last step
+            ecs::Scene stepped;
+            stepped.buffer<float>();
+            const auto e = stepped.add(float{0.0f});
+            ecs::Schedule steps;
+            steps.add<ecs::Write<float>>("move", [&]{ for (auto [entity, f] : ecs::View<float>(stepped)) f += 1.0f; });
+            steps.add<ecs::Exclusive>("store", [&]{ stepped.store(); }, system::SYSTEM_PRIORITY_FIRST);
+            for (int i = 0; i < 3; i++) steps.run();
+            return expect(stepped.interpolated<float>(e, 0.0f) == 2.0f and stepped.interpolated<float>(e, 0.5f) == 2.5f);
+        };
+    });
+
+    inline TestSuite hierarchy_tests("ecs_hierarchy", []{
+        ecs::Scene scene;
+        ecs::SceneGraph graph(scene);
+        const auto translation = [](float x) { auto m = identity<float, 4>(); m.get<0, 3>() = x; return ecs::LocalTransform{m}; };
+        const auto world_x = [&](ecs::EntityID e) { return scene.get<ecs::WorldTransform>(e)->matrix.get<0, 3>(); };
+        const auto grandchild = scene.add(translation(3.0f));
+        const auto child = scene.add(translation(2.0f));
+        const auto sibling = scene.add(translation(10.0f));
+        const auto root = scene.add(translation(1.0f));
+        graph.attach(grandchild, child);
+        graph.attach(child, root);
+        graph.attach(sibling, root);
+
+        "propagate"_test = [&]{
+            graph.propagate();
+            bool ordered = true;
+            for (std::size_t i = 0; i < graph.nodes->size(); i++) {
+                const auto& node = graph.nodes->data[i];
+                ordered = ordered and graph.locals->entity_at(i) == graph.nodes->entity_at(i) and graph.worlds->entity_at(i) == graph.nodes->entity_at(i) and
+                          (node.parent == ecs::invalid_id or (node.parent_position < i and graph.nodes->entity_at(node.parent_position) == node.parent));
+            }
+            return expect(ordered and graph.levels == std::vector<std::size_t>{0, 1, 3, 4} and world_x(root) == 1.0f and
+                          world_x(child) == 3.0f and world_x(grandchild) == 6.0f and world_x(sibling) == 11.0f);
+        };
+
+        "dirty subtrees"_test = [&]{
+            const auto since = scene.advance();
+            scene.patch<ecs::LocalTransform>(child)->matrix.get<0, 3>() = 5.0f;
+            graph.propagate(since);
+            const auto dirty = [&](ecs::EntityID e) { return graph.dirty[graph.nodes->position(e)] == 1; };
+            return expect(world_x(grandchild) == 9.0f and dirty(child) and dirty(grandchild) and not dirty(root) and not dirty(sibling));
+        };
+
+        "reparent"_test = [&]{
+            graph.attach(grandchild, sibling);
+            graph.attach(root, grandchild);
+            graph.par_propagate(0, 1);
+            std::vector<ecs::EntityID> children;
+            graph.each_child(root, [&](ecs::EntityID e) { children.push_back(e); });
+            return expect(world_x(grandchild) == 14.0f and scene.get<ecs::Node>(grandchild)->depth == 2 and graph.parent(root) == ecs::invalid_id and
+                          children == std::vector<ecs::EntityID>{sibling, child} and scene.get<ecs::Node>(child)->first_child == ecs::invalid_id);
+        };
+
+        "destroy"_test = [&]{
+            graph.destroy(sibling);
+            graph.propagate();
+            std::vector<ecs::EntityID> children;
+            graph.each_child(root, [&](ecs::EntityID e) { children.push_back(e); });
+            return expect(not scene.valid(sibling) and not scene.valid(grandchild) and children == std::vector<ecs::EntityID>{child} and
+                          graph.nodes->size() == 2 and world_x(child) == 6.0f);
+        };
+    });
+
+    inline TestSuite spatial_tests("ecs_spatial", []{
+        using detail::Agent;
+        ecs::Scene scene;
+        ecs::SpatialGrid<Agent> grid(scene, 2.0f);
+        std::vector<ecs::EntityID> agents;
+        for (int i = 0; i < 400; i++) agents.push_back(scene.add(Agent{Vec2<float>(float(i % 20) - 7.5f, float(i / 20) * 0.5f - 3.0f), i}));
+        grid.update();
+
+        //: reference results comparing every agent
+        const auto brute = [&](auto&& pred) {
+            std::vector<ecs::EntityID> result;
+            for (auto [e, a] : ecs::View<Agent>(scene)) if (pred(a.position)) result.push_back(e);
+            std::sort(result.begin(), result.end(), [](auto a, auto b) { return a.value < b.value; });
+            return result;
+        };
+        const auto sorted = [](std::vector<ecs::EntityID> v) { std::sort(v.begin(), v.end(), [](auto a, auto b) { return a.value < b.value; }); return v; };
+        const auto distance2 = [](Vec2<float> a, Vec2<float> b) { return (a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y); };
+
+        "radius and box queries"_test = [&]{
+            const Vec2<float> center(1.2f, 0.7f);
+            std::vector<ecs::EntityID> radius, box;
+            grid.query_radius(center, 3.5f, [&](ecs::EntityID e, const Vec2<float>&) { radius.push_back(e); });
+            grid.query_aabb(Vec2<float>(-4.0f, -1.0f), Vec2<float>(2.5f, 6.0f), [&](ecs::EntityID e, const Vec2<float>&) { box.push_back(e); });
+            std::vector<ecs::EntityID> all;
+            grid.query_aabb(Vec2<float>(-1e6f, -1e6f), Vec2<float>(1e6f, 1e6f), [&](ecs::EntityID e, const Vec2<float>&) { all.push_back(e); });
+            return expect(grid.size() == 400 and not radius.empty() and
+                          sorted(radius) == brute([&](Vec2<float> p) { return distance2(p, center) <= 3.5f * 3.5f; }) and
+                          sorted(box) == brute([](Vec2<float> p) { return p.x >= -4.0f and p.x <= 2.5f and p.y >= -1.0f and p.y <= 6.0f; }) and
+                          all.size() == 400);
+        };
+
+        "nearest"_test = [&]{
+            const Vec2<float> center(-20.0f, 1.3f);
+            const auto nearest = grid.nearest(center, 5);
+            auto expected = brute([](Vec2<float>) { return true; });
+            std::sort(expected.begin(), expected.end(), [&](auto a, auto b) {
+                return distance2(scene.get<Agent>(a)->position, center) < distance2(scene.get<Agent>(b)->position, center);
+            });
+            bool same = nearest.size() == 5;
+            for (std::size_t i = 0; i < nearest.size() and same; i++)
+                same = distance2(scene.get<Agent>(nearest[i])->position, center) == distance2(scene.get<Agent>(expected[i])->position, center);
+            return expect(same and grid.nearest(center, 1000).size() == 400 and grid.nearest(center, 0).empty());
+        };
+
+        "far cells"_test = [&]{
+            //: positions past the cell range are clamped to the border cells, opposite borders must not share a key
+            ecs::Scene far;
+            ecs::SpatialGrid<Vec3<float>> grid3(far, 1.0f);
+            const auto a = far.add(Vec3<float>(1e30f, 1e30f, 1e30f));
+            const auto b = far.add(Vec3<float>(-1e30f, -1e30f, -1e30f));
+            grid3.update();
+            std::vector<ecs::EntityID> found;
+            grid3.query_aabb(Vec3<float>(1e29f, 1e29f, 1e29f), Vec3<float>(1e31f, 1e31f, 1e31f), [&](ecs::EntityID e, const Vec3<float>&) { found.push_back(e); });
+            const auto nearest = grid3.nearest(Vec3<float>(-1e30f, -1e30f, -1e30f), 1);
+            return expect(grid3.cells.size() == 2 and found == std::vector{a} and nearest == std::vector{b});
+        };
+
+        "incremental update"_test = [&]{
+            const auto since = scene.advance();
+            scene.patch<Agent>(agents[0])->position = Vec2<float>(50.0f, 50.0f);
+            scene.remove(agents[1]);
+            const auto added = scene.add(Agent{Vec2<float>(51.0f, 50.0f), 400});
+            scene.cpool<Agent>().at(agents[2]).position = Vec2<float>(-50.0f, 0.0f);
+            grid.update(since);
+            std::vector<ecs::EntityID> found;
+            grid.query_radius(Vec2<float>(50.0f, 50.0f), 2.0f, [&](ecs::EntityID e, const Vec2<float>&) { found.push_back(e); });
+            bool removed = true;
+            grid.query_aabb(Vec2<float>(-1e6f, -1e6f), Vec2<float>(1e6f, 1e6f), [&](ecs::EntityID e, const Vec2<float>&) { removed = removed and e != agents[1]; });
+            return expect(grid.size() == 400 and removed and sorted(found) == sorted({agents[0], added}) and
+                          grid.nearest(Vec2<float>(-50.0f, 0.0f), 1).front() != agents[2]);
+        };
+
+        "three dimensions"_test = [&]{
+            ecs::Scene volume;
+            ecs::SpatialGrid<Vec3<float>> grid3(volume, 1.0f);
+            const auto a = volume.add(Vec3<float>(0.5f, 0.5f, 0.5f));
+            const auto b = volume.add(Vec3<float>(-0.5f, 0.5f, 3.0f));
+            volume.add(Vec3<float>(10.0f, -10.0f, 10.0f));
+            grid3.update();
+            std::vector<ecs::EntityID> found;
+            grid3.query_radius(Vec3<float>(0.0f, 0.0f, 1.5f), 2.0f, [&](ecs::EntityID e, const Vec3<float>&) { found.push_back(e); });
+            return expect(sorted(found) == sorted({a, b}) and grid3.nearest(Vec3<float>(0.0f, 0.0f, 0.0f), 1) == std::vector<ecs::EntityID>{a});
+        };
+    });
+
+    inline TestSuite tag_tests("ecs_tags", []{
+        using detail::Frozen;
+        ecs::Scene scene;
+        std::vector<ecs::EntityID> entities;
+        for (int i = 0; i < 10; i++) entities.push_back(i % 3 == 0 ? scene.add(int{i}, Frozen{}) : scene.add(int{i}));
+
+        "tag storage"_test = [&]{
+            auto& pool = scene.cpool<Frozen>();
+            return expect(ecs::concepts::TagComponent<Frozen> and sizeof(pool.data) == sizeof(std::size_t) and pool.size() == 4 and
+                          pool.data.size() == 4 and scene.get<Frozen>(entities[3]) != nullptr and scene.get<Frozen>(entities[1]) == nullptr and
+                          scene.has<int, Frozen>(entities[9]));
+        };
+
+        "tag iterators"_test = [&]{
+            //: generic code can range iterate the storage of any pool, tags yield the shared instance once per entity
+            const auto& pool = scene.cpool<Frozen>();
+            std::size_t count = 0;
+            for (const auto& f : pool.data) count += &f == &ecs::detail::TagVector<Frozen>::value;
+            static_assert(std::random_access_iterator<decltype(pool.data.begin())>);
+            return expect(count == 4 and std::distance(pool.begin(), pool.end()) == 4 and std::distance(pool.data.rbegin(), pool.data.rend()) == 4);
+        };
+
+        "remove tags"_test = [&]{
+            scene.cpool<Frozen>().remove(entities[0]);
+            scene.remove(entities[6]);
+            scene.cpool<Frozen>().add(entities[1], Frozen{});
+            return expect(scene.cpool<Frozen>().size() == 3 and scene.cpool<Frozen>().data.size() == 3 and
+                          scene.has<Frozen>(entities[1]) and not scene.has<Frozen>(entities[0]) and scene.cpool<int>().size() == 9);
+        };
+
+        "views skip tags"_test = [&]{
+            int sum = 0, count = 0;
+            for (auto [e, i] : ecs::View<int, Frozen>(scene)) sum += i;
+            ecs::View<Frozen, int>(scene).each([&](ecs::EntityID, int& i) { sum += i; });
+            for (auto [e] : ecs::View<Frozen>(scene)) count++;
+            ecs::View<Frozen>(scene).each([&](ecs::EntityID) { count++; });
+            static_assert(std::tuple_size_v<decltype(*ecs::View<int, Frozen>(scene).begin())> == 2);
+            return expect(sum == 2 * (1 + 3 + 9) and count == 6);
+        };
+
+        "groups and queries skip tags"_test = [&]{
+            int grouped = 0, queried = 0;
+            scene.group<int, Frozen>().each([&](ecs::EntityID, int& i) { grouped += i; });
+            scene.query<Frozen>().each([&](ecs::EntityID) { queried++; });
+            scene.query<int, Frozen>().each([&](ecs::EntityID, int& i) { queried += i; });
+            return expect(grouped == 1 + 3 + 9 and queried == 3 + 1 + 3 + 9);
+        };
+
+        "tag snapshot"_test = [&]{
+            ecs::Scene tagged, loaded;
+            const auto a = tagged.add(int{1}, Frozen{});
+            const auto b = tagged.add(int{2});
+            const auto path = (std::filesystem::temp_directory_path() / "fresa_ecs_tag_snapshot_test.bin").string();
+            const bool ok = ecs::save_snapshot<int, Frozen>(tagged, path) and ecs::load_snapshot<int, Frozen>(loaded, path);
+            std::filesystem::remove(path);
+            return expect(ok and loaded.has<Frozen>(a) and not loaded.has<Frozen>(b) and loaded.cpool<Frozen>().size() == 1 and *loaded.get<int>(b) == 2);
+        };
+    });
+
+    inline TestSuite soa_tests("ecs_soa", []{
+        using detail::Particle;
+        ecs::Scene scene;
+        for (int i = 0; i < 100; i++) scene.add(Particle{(float)i, 0.0f, i}, int{i});
+
+        "soa storage"_test = [&]{
+            auto& pool = scene.cpool<Particle>();
+            const auto aligned = [](const auto column) { return reinterpret_cast<std::uintptr_t>(column.data()) % 64 == 0; };
+            return expect(std::same_as<decltype(pool.data), ecs::detail::SoAVector<Particle>> and pool.size() == 100 and
+                          pool.data.field<&Particle::x>().size() == 100 and pool.data.field<&Particle::id>()[42] == 42 and
+                          aligned(pool.data.field<&Particle::x>()) and aligned(pool.data.field<&Particle::y>()));
+        };
+
+        "get and patch"_test = [&]{
+            const auto e = ecs::id(10, 0);
+            const bool read = scene.get<Particle>(e)->x == 10.0f and scene.get<Particle>(ecs::id(200, 0)) == nullptr;
+            (*scene.patch<Particle>(e)).field<&Particle::y>() = 5.0f;
+            *scene.patch<Particle>(ecs::id(11, 0)) = Particle{1.0f, 2.0f, 3};
+            const Particle p = *scene.get<Particle>(ecs::id(11, 0));
+            return expect(read and scene.get<Particle>(e)->y == 5.0f and p.x == 1.0f and p.y == 2.0f and p.id == 3);
+        };
+
+        "remove keeps fields together"_test = [&]{
+            for (int i = 0; i < 100; i += 2) scene.remove(ecs::id(i, 0));
+            *scene.patch<Particle>(ecs::id(11, 0)) = Particle{11.0f, 0.0f, 11};
+            bool same = scene.cpool<Particle>().size() == 50;
+            for (auto [e, p, i] : ecs::View<Particle, int>(scene))
+                same = same and p.field<&Particle::id>() == i and (int)p.field<&Particle::x>() == i and (int)ecs::index(e).value == i;
+            return expect(same);
+        };
+
+        "group with soa pools"_test = [&]{
+            scene.cpool<int>().remove(ecs::id(21, 0));
+            auto& g = scene.group<int, Particle>();
+            float sum = 0.0f;
+            g.each([&](ecs::EntityID, int&, ecs::ComponentRef<Particle> p) { sum += p.field<&Particle::x>(); });
+            const auto xs = scene.cpool<Particle>().data.field<&Particle::x>();
+            bool packed = g.size() == 49;
+            for (std::size_t i = 0; i < g.size(); i++) packed = packed and (int)xs[i] == scene.cpool<int>().data[i];
+            return expect(packed and sum == 2500.0f - 21.0f);
+        };
+    });
+
+    inline TestSuite storage_tests("ecs_storage", []{
+        using namespace detail;
+        ecs::Scene scene;
+        const auto first = scene.add(Stable{0}, Pooled{0}, Huge{0.0f});
+        const auto stable = scene.get<Stable>(first);
+        const auto huge = scene.get<Huge>(first);
+        for (int i = 1; i < 1000; i++) scene.add(Stable{i}, Pooled{i}, Huge{(float)i});
+
+        "paged storage"_test = [&]{
+            auto& pool = scene.cpool<Stable>();
+            return expect(std::same_as<decltype(pool.data), ecs::detail::PagedVector<Stable>> and pool.data.pages.size() == 16 and
+                          scene.get<Stable>(first) == stable and stable->value == 0 and scene.get<Stable>(ecs::id(999, 0))->value == 999);
+        };
+
+        "paged storage remove and sort"_test = [&]{
+            for (int i = 1; i < 1000; i += 2) scene.remove(ecs::id(i, 0));
+            auto& pool = scene.cpool<Stable>();
+            pool.sort_by([](const Stable& s) { return -s.value; });
+            bool same = pool.size() == 500 and pool.data[0].value == 998 and std::is_sorted(pool.rbegin(), pool.rend(), [](auto& a, auto& b) { return a.value < b.value; });
+            for (auto [e, s, p] : ecs::View<Stable, Pooled>(scene)) same = same and s.value == p.value and s.value == (int)ecs::index(e).value;
+            return expect(same);
+        };
+
+        "allocator"_test = [&]{
+            const bool pooled = counting_resource.allocated >= 1000 * sizeof(Pooled) and scene.cpool<Pooled>().data.get_allocator().resource() == &counting_resource;
+            return expect(pooled and scene.get<Huge>(first) == huge and scene.cpool<Huge>().data.pages.size() == 1 and
+                          reinterpret_cast<std::uintptr_t>(huge) % ecs::HugePageAllocator<Huge>::huge_page_size == 0);
+        };
+
+        "paged allocator assignment"_test = [&]{
+            ecs::Scene buffered;
+            for (int i = 0; i < 40; i++) buffered.add(PagedPooled{i});
+            auto& pool = buffered.cpool<PagedPooled>();
+            buffered.buffer<PagedPooled>();
+            for (auto& c : pool.data) c.value *= 2;
+            buffered.store();
+            bool ok = pool.previous.size() == 40 and pool.previous[39].value == 78;
+
+            using Pages = ecs::detail::PagedVector<PagedPooled>;
+            Pages other(std::pmr::polymorphic_allocator<PagedPooled>(std::pmr::new_delete_resource()));
+            for (int i = 0; i < 20; i++) other.emplace_back(i);
+            const auto allocated = counting_resource.allocated;
+            pool.previous = std::move(other);
+            ok = ok and pool.previous.allocator.resource() == &counting_resource and counting_resource.allocated == allocated and other.empty();
+            for (int i = 0; i < 20; i++) ok = ok and pool.previous[i].value == i;
+            pool.previous = Pages(pool.data);
+            return expect(ok and pool.previous.size() == 40 and pool.previous[39].value == 78);
+        };
+
+        "paged snapshot"_test = [&]{
+            const auto path = (std::filesystem::temp_directory_path() / "fresa_ecs_storage_test.bin").string();
+            ecs::Scene loaded;
+            bool ok = ecs::save_snapshot<Stable, Pooled>(scene, path) and ecs::load_snapshot<Stable, Pooled>(loaded, path);
+            std::filesystem::remove(path);
+            for (auto [e, s, p] : ecs::View<Stable, Pooled>(loaded)) ok = ok and s.value == p.value and s.value == (int)ecs::index(e).value;
+            return expect(ok and loaded.cpool<Stable>().size() == 500 and
+                          std::equal(loaded.cpool<Stable>().begin(), loaded.cpool<Stable>().end(), scene.cpool<Stable>().begin(), [](auto& a, auto& b) { return a.value == b.value; }));
+        };
+    });
+
+    inline TestSuite memory_tests("ecs_memory", []{
+        using namespace detail;
+        constexpr std::size_t page = ecs::detail::SparseArray::page_size;
+        ecs::Scene scene;
+        std::vector<ecs::EntityID> entities;
+        for (std::size_t i = 0; i < 4 * page; i++) entities.push_back(scene.add(int{(int)i}, Stable{(int)i}));
+
+        "pool memory"_test = [&]{
+            const auto m = scene.cpool<int>().memory();
+            return expect(m.entities == 4 * page and m.sparse_pages == 4 and m.dense_size == 4 * page and m.dense_capacity >= m.dense_size and
+                          m.data_bytes >= 4 * page * sizeof(int) and m.bookkeeping_bytes == 0 and m.bytes_per_entity() > (double)sizeof(int) and
+                          scene.memory().entities == 8 * page);
+        };
+
+        "compact after removing"_test = [&]{
+            //: only the first entity of the third sparse page is left, paged storage doesn't move it while compacting
+            const auto kept = entities[2 * page];
+            for (const auto e : entities) if (e != kept) scene.remove(e);
+            const auto stable = scene.get<Stable>(kept);
+            const auto peak = scene.memory().bytes();
+            scene.compact();
+            const auto& pool = scene.cpool<int>();
+            const auto m = pool.memory();
+            return expect(m.sparse_pages == 1 and pool.sparse.pages.size() == 3 and m.dense_capacity == 1 and pool.data.capacity() == 1 and
+                          scene.memory().bytes() < peak / 4 and *scene.get<int>(kept) == int(2 * page) and scene.get<Stable>(kept) == stable and
+                          scene.cpool<Stable>().data.pages.size() == 1 and scene.signatures.size() == 2 * page + 1);
+        };
+
+        "grow after compact"_test = [&]{
+            for (std::size_t i = 0; i < 2 * page; i++) scene.add(int{1}, Stable{1});
+            int sum = 0;
+            for (auto [e, i, s] : ecs::View<int, Stable>(scene)) sum += i + s.value;
+            return expect(scene.cpool<int>().size() == 2 * page + 1 and sum == int(2 * page) * 2 + int(2 * page) * 2 and
+                          scene.cpool<int>().memory().sparse_pages >= 2);
+        };
+    });
+
+    inline TestSuite snapshot_tests("ecs_snapshot", []{
+        using detail::Particle;
+        const auto path = (std::filesystem::temp_directory_path() / "fresa_ecs_snapshot_test.bin").string();
+        ecs::Scene scene;
+        for (int i = 0; i < 600; i++) scene.add(int{i}, Particle{(float)i, 1.0f, i}, float{0.5f});
+        for (int i = 0; i < 600; i += 3) scene.cpool<Particle>().remove(ecs::id(i, 0));
+        scene.remove(ecs::id(7, 0));
+        const auto reused = scene.add(int{-7});
+
+        "save"_test = [&]{
+            return expect(ecs::save_snapshot<int, Particle>(scene, path) and std::filesystem::exists(path));
+        };
+
+        "load"_test = [&]{
+            ecs::Scene loaded;
+            bool ok = ecs::load_snapshot<int, Particle>(loaded, path);
+            ok = ok and loaded.cpool<int>().size() == scene.cpool<int>().size() and loaded.cpool<Particle>().size() == scene.cpool<Particle>().size();
+            ok = ok and *loaded.get<int>(reused) == -7 and loaded.get<int>(ecs::id(7, 0)) == nullptr and loaded.get<Particle>(ecs::id(3, 0)) == nullptr;
+            ok = ok and loaded.get<Particle>(ecs::id(4, 0))->x == 4.0f and not loaded.has<float>(ecs::id(4, 0));
+            ok = ok and loaded.has<int, Particle>(ecs::id(4, 0)) and not loaded.has<int, Particle>(ecs::id(3, 0));
+            for (auto [e, i, p] : ecs::View<int, Particle>(loaded)) ok = ok and p.field<&Particle::id>() == i;
+            ok = ok and loaded.entities == scene.entities and loaded.free_list == scene.free_list and loaded.add(int{1}) == scene.add(int{1});
+            return expect(ok);
+        };
+
+        "skip pools"_test = [&]{
+            ecs::Scene loaded;
+            return expect(ecs::load_snapshot<Particle>(loaded, path) and loaded.cpool<Particle>().size() == scene.cpool<Particle>().size() and
+                          not loaded.component_pools.contains(type_hash<int>()));
+        };
+
+        "reject"_test = [&]{
+            ecs::Scene full;
+            full.add(int{1});
+            const bool not_empty = not ecs::load_snapshot<int>(full, path) and full.cpool<int>().size() == 1;
+            std::filesystem::resize_file(path, std::filesystem::file_size(path) / 2);
+            ecs::Scene loaded;
+            const bool truncated = not ecs::load_snapshot<int, Particle>(loaded, path) and loaded.component_pools.empty();
+            std::filesystem::remove(path);
+            return expect(not_empty and truncated and not ecs::load_snapshot<int>(loaded, path));
+        };
+
+        "pages with gaps"_test = [&]{
+            //: the only page of the pool is past the first one, so page numbers go beyond the number of allocated pages
+            ecs::Scene sparse;
+            for (int i = 0; i < 1001; i++) sparse.add();
+            sparse.cpool<float>().add(ecs::id(1000, 0), float{2.5f});
+            ecs::Scene loaded;
+            const bool ok = ecs::save_snapshot<float>(sparse, path) and ecs::load_snapshot<float>(loaded, path);
+            std::filesystem::remove(path);
+            return expect(ok and loaded.cpool<float>().size() == 1 and loaded.get<float>(ecs::id(1000, 0)) != nullptr and
+                          *loaded.get<float>(ecs::id(1000, 0)) == 2.5f);
+        };
+
+        "corrupt indices"_test = [&]{
+            //: the dense array is the only aligned blob starting with the index 1000, point it past the entities of the snapshot
+            ecs::Scene sparse;
+            for (int i = 0; i < 1001; i++) sparse.add();
+            sparse.cpool<float>().add(ecs::id(1000, 0), float{2.5f});
+            bool ok = ecs::save_snapshot<float>(sparse, path);
+            std::vector<char> bytes(std::filesystem::file_size(path));
+            std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+            file.read(bytes.data(), (std::streamsize)bytes.size());
+            const ecs::Index dense(1000), corrupt(1001);
+            std::size_t found = 0;
+            for (std::size_t i = 0; i + sizeof(ecs::Index) <= bytes.size(); i += 64) {
+                if (std::memcmp(&bytes[i], &dense, sizeof(ecs::Index)) != 0) continue;
+                file.seekp((std::streamoff)i);
+                file.write(reinterpret_cast<const char*>(&corrupt), sizeof(ecs::Index));
+                found++;
+            }
+            file.close();
+            ecs::Scene loaded;
+            ok = ok and found == 1 and not ecs::load_snapshot<float>(loaded, path) and loaded.entities.empty();
+            std::filesystem::remove(path);
+            return expect(ok);
+        };
+
+        "corrupt free list"_test = [&]{
+            //: slots 1 and 2 are free (2 -> 1 -> end), the entities array is the first aligned blob after the header
+            ecs::Scene freed;
+            for (int i = 0; i < 4; i++) freed.add(float{(float)i});
+            freed.remove(ecs::id(1, 0));
+            freed.remove(ecs::id(2, 0));
+            bool ok = ecs::save_snapshot<float>(freed, path);
+            const auto offset = (std::streamoff)((sizeof(ecs::detail::SnapshotHeader) + 63) / 64 * 64);
+            const auto load_with = [&](const std::size_t slot, const ecs::EntityID value) {
+                std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+                std::vector<ecs::EntityID> entities(freed.entities.size());
+                file.seekg(offset);
+                file.read(reinterpret_cast<char*>(entities.data()), (std::streamsize)(entities.size() * sizeof(ecs::EntityID)));
+                const bool saved = entities == freed.entities;
+                entities[slot] = value;
+                file.seekp(offset);
+                file.write(reinterpret_cast<const char*>(entities.data()), (std::streamsize)(entities.size() * sizeof(ecs::EntityID)));
+                file.close();
+                ecs::Scene loaded;
+                const bool loads = ecs::load_snapshot<float>(loaded, path);
+                return saved and not loads and loaded.entities.empty();
+            };
+            //: a chain that loops back to slot 2, a link past the entities, an alive slot with a version its pool entry doesn't have
+            //      and an alive slot holding another index
+            ok = ok and load_with(1, ecs::id(2, 1));
+            ok = ok and ecs::save_snapshot<float>(freed, path) and load_with(1, ecs::id(100, 1));
+            ok = ok and ecs::save_snapshot<float>(freed, path) and load_with(0, ecs::id(0, 3));
+            ok = ok and ecs::save_snapshot<float>(freed, path) and load_with(3, ecs::id(0, 0));
+            ecs::Scene loaded;
+            ok = ok and ecs::save_snapshot<float>(freed, path) and ecs::load_snapshot<float>(loaded, path) and loaded.add() == ecs::id(2, 1) and loaded.add() == ecs::id(1, 1);
+            std::filesystem::remove(path);
+            return expect(ok);
+        };
+    });
+
+    inline TestSuite group_tests("ecs_group", []{
+        ecs::Scene scene;
+        for (int i = 0; i < 10; i++) {
+            const auto e = scene.add(int{i});
+            if (i % 2 == 0) scene.cpool<float>().add(e, float(i));
+        }
+
+        //: checks that the packed range of both pools holds the same entities in the same order, and that the group ids match them
+        auto packed = [&](std::size_t n) {
+            auto& g = scene.group<int, float>();
+            bool same = g.size() == n and g.entities.size() == n;
+            for (std::size_t i = 0; i < g.size(); i++)
+                same = same and scene.cpool<int>().dense[i] == scene.cpool<float>().dense[i] and
+                       (float)scene.cpool<int>().data[i] == scene.cpool<float>().data[i] and g.entities[i] == scene.cpool<int>().entity_at(i);
+            return same;
+        };
+
+        "create group"_test = [&]{
+            auto& g = scene.group<int, float>();
+            return expect(packed(5) and scene.groups.size() == 1 and &g == &scene.group<int, float>());
+        };
+
+        "add to group"_test = [&]{
+            scene.cpool<float>().add(ecs::id(3, 0), float{3.0f});
+            scene.add(int{10});
+            scene.add(int{11}, float{11.0f});
+            return expect(packed(7));
+        };
+
+        "remove from group"_test = [&]{
+            scene.cpool<float>().remove(ecs::id(4, 0));
+            scene.remove(ecs::id(0, 0));
+            scene.remove(ecs::id(1, 0));
+            return expect(packed(5) and scene.cpool<int>().size() == 10 and scene.cpool<float>().size() == 5);
+        };
+
+        "group each"_test = [&]{
+            int sum = 0;
+            scene.group<int, float>().each([&](ecs::EntityID, int& i, float&) { sum += i; });
+            return expect(sum == 2 + 3 + 6 + 8 + 11);
+        };
+
+        "recycled ids"_test = [&]{
+            //: the ids passed to each keep the version of recycled entities
+            const auto recycled = scene.add(int{12}, float{12.0f});
+            bool found = false;
+            scene.group<int, float>().each([&](ecs::EntityID e, int&, float&) { found = found or e == recycled; });
+            scene.cpool<float>().clear();
+            return expect(ecs::version(recycled) == ecs::Version(1) and found and packed(0));
+        };
+    });
+
+    inline TestSuite query_tests("ecs_query", []{
+        ecs::Scene scene;
+        for (int i = 0; i < 10; i++) {
+            const auto e = scene.add(int{i});
+            if (i % 2 == 0) scene.cpool<float>().add(e, float(i));
+        }
+
+        //: checks that the query holds the same entities as the equivalent view
+        auto matches = [&](std::size_t n) {
+            auto& q = scene.query<int, float>();
+            std::vector<ecs::EntityID> cached(q.begin(), q.end()), viewed;
+            for (auto [e, i, f] : ecs::View<int, float>(scene)) viewed.push_back(e);
+            const auto by_value = [](auto a, auto b) { return a.value < b.value; };
+            std::sort(cached.begin(), cached.end(), by_value);
+            std::sort(viewed.begin(), viewed.end(), by_value);
+            return q.size() == n and cached == viewed;
+        };
+
+        "create query"_test = [&]{
+            auto& q = scene.query<int, float>();
+            return expect(matches(5) and scene.queries.size() == 1 and &q == &scene.query<int, float>() and
+                          scene.cpool<int>().queries.size() == 1 and scene.cpool<float>().queries.size() == 1);
+        };
+
+        "add and remove"_test = [&]{
+            scene.cpool<float>().add(ecs::id(3, 0), float{3.0f});
+            scene.add(int{10});
+            scene.add(int{11}, float{11.0f});
+            const bool added = matches(7);
+            scene.cpool<float>().remove(ecs::id(4, 0));
+            scene.remove(ecs::id(0, 0));
+            scene.remove(ecs::id(1, 0));
+            return expect(added and matches(5) and not scene.query<int, float>().contains(ecs::id(4, 0)));
+        };
+
+        "recycled and bulk"_test = [&]{
+            const auto recycled = scene.add(int{12}, float{12.0f});
+            const auto bulk = scene.add_n(3, int{13}, float{13.0f});
+            return expect(ecs::index(recycled) == ecs::Index(1) and matches(9) and scene.query<int, float>().contains(recycled) and
+                          scene.query<int, float>().contains(bulk.front()));
+        };
+
+        "query each"_test = [&]{
+            int sum = 0;
+            scene.query<int, float>().each([&](ecs::EntityID, int& i, float& f) { sum += i; f += 1.0f; });
+            return expect(sum == 2 + 3 + 6 + 8 + 11 + 12 + 13 * 3 and *scene.get<float>(ecs::id(2, 0)) == 3.0f);
+        };
+
+        "groups and other queries"_test = [&]{
+            //: owning groups reorder the pools, which doesn't affect the queries sharing them
+            scene.group<int, float>();
+            auto& ints = scene.query<int>();
+            const bool grouped = matches(9) and ints.size() == scene.cpool<int>().size();
+            scene.cpool<float>().clear();
+            const bool cleared = matches(0) and ints.size() == scene.cpool<int>().size();
+            scene.drop_query<int>();
+            return expect(grouped and cleared and scene.queries.size() == 1 and scene.cpool<int>().queries.size() == 1);
+        };
+    });
+
+    inline TestSuite archetype_scene_tests("ecs_archetype_scene", []{
+        ecs::ArchetypeScene scene;
+
+        "add entity"_test = [&]{
+            auto e1 = scene.add(int{1}, float{2.0f});
+            auto e2 = scene.add(float{3.0f}, int{4});
+            auto e3 = scene.add(int{5});
+            return expect(e1 == ecs::id(0, 0) and e2 == ecs::id(1, 0) and e3 == ecs::id(2, 0) and scene.archetypes.size() == 2 and
+                          *scene.get<int>(e2) == 4 and *scene.get<float>(e2) == 3.0f and scene.get<float>(e3) == nullptr);
+        };
+
+        "repeated components"_test = [&]{
+            //: add rejects these at compile time, since a repeated type would share a single column
+            return expect(ecs::detail::unique_types<int, float, const char*> and not ecs::detail::unique_types<int, float, int>);
+        };
+
+        "emplace component"_test = [&]{
+            scene.emplace(ecs::id(2, 0), float{6.0f});
+            return expect(scene.archetypes.size() == 2 and *scene.get<int>(ecs::id(2, 0)) == 5 and *scene.get<float>(ecs::id(2, 0)) == 6.0f and
+                          *scene.get<int>(ecs::id(0, 0)) == 1 and *scene.get<int>(ecs::id(1, 0)) == 4);
+        };
+
+        "erase component"_test = [&]{
+            scene.erase<int>(ecs::id(0, 0));
+            return expect(scene.get<int>(ecs::id(0, 0)) == nullptr and *scene.get<float>(ecs::id(0, 0)) == 2.0f and
+                          *scene.get<int>(ecs::id(2, 0)) == 5 and *scene.get<float>(ecs::id(2, 0)) == 6.0f);
+        };
+
+        "remove entity"_test = [&]{
+            scene.remove(ecs::id(1, 0));
+            auto e = scene.add(int{7});
+            return expect(not scene.valid(ecs::id(1, 0)) and e == ecs::id(1, 1) and scene.get<int>(ecs::id(1, 0)) == nullptr and
+                          *scene.get<int>(e) == 7 and *scene.get<int>(ecs::id(2, 0)) == 5);
+        };
+
+        "each"_test = [&]{
+            int sum = 0;
+            scene.each<int, float>([&](ecs::EntityID, int& i, float& f) { sum += i + (int)f; });
+            int count = 0;
+            scene.each<float>([&](ecs::EntityID, float&) { count++; });
+            return expect(sum == 5 + 6 and count == 2);
+        };
+
+        "multiple chunks"_test = [&]{
+            ecs::ArchetypeScene large;
+            std::vector<ecs::EntityID> entities;
+            for (int i = 0; i < 10000; i++) entities.push_back(large.add(int{i}, str{"component"}));
+            for (int i = 0; i < 10000; i += 2) large.remove(entities.at(i));
+            long sum = 0;
+            large.each<int, str>([&](ecs::EntityID, int& i, str&) { sum += i; });
+            const auto& a = *large.archetypes.begin()->second;
+            return expect(sum == 25000000 and a.count == 5000 and a.chunks.size() == (5000 + a.capacity - 1) / a.capacity);
+        };
     });
 }
 